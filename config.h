@@ -1,99 +1,269 @@
-#ifndef _CONFIG_H_
-#define _CONFIG_H_
-
-#include <stdint.h>
-#include <time.h>
-#include <unistd.h>
-#include <pthread.h>
-
-#ifdef BUILDING_GATEWAY
-	#ifndef TIMEOUT
-        #error TIMEOUT not set
-    #endif
-    #ifndef SET_MAX_TEMP
-        #error SET_MAX_TEMP not set
-    #endif
-    #ifndef SET_MIN_TEMP
-        #error SET_MIN_TEMP not set
-    #endif
-
-	#define PIPE_BUF 80
-	#define CHILD_POS "\t\t\t"
-
-	#ifndef MAX_CONN
-		#define MAX_CONN 5  // state the max. number of connections the server will handle before exiting
-	#endif
-
-	#ifndef RUN_AVG_LENGTH
-		#define RUN_AVG_LENGTH 5
-	#endif
-
-	#ifndef STORAGE_INIT_ATTEMPTS
-		#define STORAGE_INIT_ATTEMPTS 3
-	#endif
-
-	#define NUM_THREADS 3
-	#define READER_THREADS 2
-
-	#define THREAD_SUCCESS 0
-	#define THREAD_ERR_FILEIO 1
-
-	#define DATAMGR_FILE_PARSE_ERROR 2
-	#define DATAMGR_INTERRUPTED_BY_STORAGEMGR 3
-
-	#define CONNMGR_INCORRECT_PORT 4
-	#define CONNMGR_SERVER_OPEN_ERROR 5
-	#define CONNMGR_SERVER_CLOSE_ERROR 6
-	#define CONNMGR_SERVER_CONNECTION_ERROR 7
-	#define CONNMGR_SERVER_POLL_ERROR 8
-	#define CONNMGR_INTERRUPTED_BY_STORAGEMGR 9
-#endif
-
-typedef uint16_t sensor_id_t;
-typedef double sensor_value_t;     
-typedef time_t sensor_ts_t;         // UTC timestamp as returned by time() - notice that the size of time_t is different on 32/64 bit machine
-
-typedef struct{
-	sensor_id_t id;
-	sensor_value_t value;
-	sensor_ts_t ts;
-} sensor_data_t;
-
-typedef struct {
-	pthread_rwlock_t * sbuffer_rwlock;
-	pthread_mutex_t * pipe_mutex;
-	pthread_mutex_t * stdio_mutex;
-	int * sbuffer_flag;
-	int * ipc_pipe_fd;
-	int * status;
-	int id;
-} storagemgr_init_arg_t;
-
-typedef struct {
-	pthread_rwlock_t * sbuffer_rwlock;
-	pthread_mutex_t * pipe_mutex;
-	pthread_mutex_t * stdio_mutex;
-	pthread_rwlock_t * storagemgr_failed_rwlock;
-	pthread_mutex_t * connmgr_drop_conn_mutex;
-	sensor_id_t * connmgr_sensor_to_drop;
-	int * sbuffer_flag;
-	int * storagemgr_fail_flag;
-	int * ipc_pipe_fd;
-	int * status;
-	int id;
-} datamgr_init_arg_t;
-
-typedef struct {
-	pthread_rwlock_t * sbuffer_rwlock;
-	pthread_mutex_t * pipe_mutex;
-	pthread_mutex_t * stdio_mutex;
-	pthread_rwlock_t * storagemgr_failed_rwlock;
-	pthread_mutex_t * connmgr_drop_conn_mutex;
-	sensor_id_t * connmgr_sensor_to_drop;
-	int * sbuffer_flag;
-	int * storagemgr_fail_flag;
-	int * ipc_pipe_fd;
-	int * status;
-} connmgr_init_arg_t;
-			
+#ifndef _CONFIG_H_
+#define _CONFIG_H_
+
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+
+#ifdef BUILDING_GATEWAY
+	#ifndef TIMEOUT
+        #error TIMEOUT not set
+    #endif
+    #ifndef SET_MAX_TEMP
+        #error SET_MAX_TEMP not set
+    #endif
+    #ifndef SET_MIN_TEMP
+        #error SET_MIN_TEMP not set
+    #endif
+
+	#define PIPE_BUF 80
+	#define CHILD_POS "\t\t\t"
+
+	#ifndef MAX_CONN
+		#define MAX_CONN 5  // state the max. number of connections the server will handle before exiting
+	#endif
+
+	#ifndef RUN_AVG_LENGTH
+		#define RUN_AVG_LENGTH 5
+	#endif
+
+	#ifndef STORAGE_INIT_ATTEMPTS
+		#define STORAGE_INIT_ATTEMPTS 3
+	#endif
+
+	#ifndef STORAGE_BUSY_TIMEOUT
+		#define STORAGE_BUSY_TIMEOUT 5000 // max. time in ms a storagemgr thread waits for another one to release the DB
+	#endif
+
+	#ifndef STORAGE_COMMIT_ATTEMPTS
+		#define STORAGE_COMMIT_ATTEMPTS 3 // times a batch is rolled back and written again before storagemgr gives up
+	#endif
+
+	#ifndef SBUFFER_RING_SIZE
+		#define SBUFFER_RING_SIZE 4096 // number of readings the ring engine of the shared buffer can hold, power of 2
+	#endif
+
+	#ifndef SBUFFER_BATCH_SIZE
+		#define SBUFFER_BATCH_SIZE 64 // max. number of readings a reader thread takes from the shared buffer at once
+	#endif
+
+	#ifndef SBUFFER_WAIT_SPINS
+		#define SBUFFER_WAIT_SPINS 256 // times an idle reader polls the shared buffer before parking, 0 parks immediately
+	#endif
+
+	#ifndef SBUFFER_WAIT_TIMEOUT
+		#define SBUFFER_WAIT_TIMEOUT 500 // max. time in ms an idle reader stays parked before re-checking shutdown flags
+	#endif
+
+	#ifndef SBUFFER_POOL_CAPACITY
+		#define SBUFFER_POOL_CAPACITY 4096 // nodes preallocated by the linked-list engine of the shared buffer
+	#endif
+
+	#ifndef SBUFFER_POOL_GROWTH
+		#define SBUFFER_POOL_GROWTH 1024 // nodes added to the pool each time it runs out of free nodes
+	#endif
+
+	#ifndef SBUFFER_POOL_CACHE_SIZE
+		#define SBUFFER_POOL_CACHE_SIZE 64 // free nodes each thread keeps to itself before returning them to the pool
+	#endif
+
+	#define SBUFFER_POLICY_BLOCK 0		// producer waits until the slowest reader frees space
+	#define SBUFFER_POLICY_DROP_OLDEST 1	// oldest unread readings of the shard are discarded to make space, whichever sensor they are from
+	#define SBUFFER_POLICY_DROP_NEWEST 2	// readings that do not fit are discarded, whichever sensor they are from
+	// both drop policies evict per shard and not per sensor, a chatty sensor pushes out the readings of the
+	// other sensors of its shard (SBUFFER_SHARDS spreads sensors over shards, it does not isolate them)
+	#define SBUFFER_POLICY_SPILL 3		// readings that do not fit go to disk, readers get them back in order
+
+	#ifndef SBUFFER_POLICY
+		#define SBUFFER_POLICY SBUFFER_POLICY_BLOCK // what the shared buffer does with readings inserted while it is full
+	#endif
+
+	#ifndef SBUFFER_CAPACITY
+		#define SBUFFER_CAPACITY 65536 // max. number of unread readings in the shared buffer, the ring engine is also bound by SBUFFER_RING_SIZE
+	#endif
+
+	#ifndef SBUFFER_HIGH_WATER
+		#define SBUFFER_HIGH_WATER 75 // fill level in % of the capacity at which connmgr stops reading from sensors
+	#endif
+
+	#ifndef SBUFFER_LOW_WATER
+		#define SBUFFER_LOW_WATER 50 // fill level in % of the capacity at which connmgr resumes reading from sensors
+	#endif
+
+	#ifndef SBUFFER_SPILL_DIR
+		#define SBUFFER_SPILL_DIR "." // directory the spill segment files are created in (SBUFFER_POLICY_SPILL)
+	#endif
+
+	#ifndef SBUFFER_SPILL_SEGMENT
+		#define SBUFFER_SPILL_SEGMENT 65536 // readings per spill segment file
+	#endif
+
+	#ifndef SBUFFER_SPILL_MAX_SEGMENTS
+		#define SBUFFER_SPILL_MAX_SEGMENTS 256 // spill segments per buffer, readings beyond are dropped
+	#endif
+
+	#ifndef CONNMGR_BACKPRESSURE_POLL
+		#define CONNMGR_BACKPRESSURE_POLL 10 // interval in ms at which a paused connmgr re-checks the shared buffer fill level
+	#endif
+
+	#define CONNMGR_BACKEND_POLL 0		// poll() over an array of descriptors rebuilt on every connect and disconnect
+	#define CONNMGR_BACKEND_EPOLL 1		// edge-triggered epoll, connections are reached through the epoll user data
+	#define CONNMGR_BACKEND_URING 2		// io_uring with multishot accept and receive into provided buffers, poll if the kernel lacks it
+
+	#ifndef CONNMGR_BACKEND
+		#define CONNMGR_BACKEND CONNMGR_BACKEND_POLL // event loop connmgr waits for sensors with
+	#endif
+
+	#ifndef CONNMGR_EPOLL_EVENTS
+		#define CONNMGR_EPOLL_EVENTS 256 // max. number of ready descriptors taken from one epoll_wait (CONNMGR_BACKEND_EPOLL)
+	#endif
+
+	#ifndef CONNMGR_READ_BUDGET
+		#define CONNMGR_READ_BUDGET 64 // max. number of readings taken from one connection per wakeup, the others get their turn first (CONNMGR_BACKEND_EPOLL)
+	#endif
+
+	#ifndef CONNMGR_URING_ENTRIES
+		#define CONNMGR_URING_ENTRIES 256 // submission entries of the io_uring of each worker (CONNMGR_BACKEND_URING)
+	#endif
+
+	#ifndef CONNMGR_URING_BUFFERS
+		#define CONNMGR_URING_BUFFERS 256 // provided receive buffers shared by the connections of a worker, power of 2 (CONNMGR_BACKEND_URING)
+	#endif
+
+	#ifndef CONNMGR_URING_BUFFER_SIZE
+		#define CONNMGR_URING_BUFFER_SIZE 2048 // bytes of one provided receive buffer (CONNMGR_BACKEND_URING)
+	#endif
+
+	#ifndef CONNMGR_RX_BUFFER
+		#define CONNMGR_RX_BUFFER 4096 // bytes of the receive buffer of each connection, one recv takes at most this much
+	#endif
+
+	#ifndef CONNMGR_TABLE_SIZE
+		#define CONNMGR_TABLE_SIZE 64 // initial number of slots of the socket descriptor indexed connection table, doubled as higher descriptors show up
+	#endif
+
+	#ifndef CONNMGR_WORKERS
+		#define CONNMGR_WORKERS 1 // connmgr event loop threads, each listens on the port with SO_REUSEPORT and owns the connections it accepts
+	#endif
+
+	#ifndef CONNMGR_QUEUE_SIZE
+		#define CONNMGR_QUEUE_SIZE 64 // commands each connmgr worker can have waiting in its queue, power of 2
+	#endif
+
+	#ifndef CONNMGR_WHEEL_TICK
+		#define CONNMGR_WHEEL_TICK 100 // granularity in ms of the timer wheel idle connections are timed out by, they close at most one tick after TIMEOUT
+	#endif
+
+	#ifndef CONNMGR_WHEEL_SLOTS
+		#define CONNMGR_WHEEL_SLOTS 64 // slots of the timer wheel, power of 2, expiring is O(expired) while CONNMGR_WHEEL_SLOTS*CONNMGR_WHEEL_TICK spans TIMEOUT
+	#endif
+
+	#ifndef SBUFFER_MAX_READERS
+		#define SBUFFER_MAX_READERS 8 // upper bound on readers subscribed to the shared buffer at the same time
+	#endif
+
+	#ifndef SBUFFER_SHARDS
+		#define SBUFFER_SHARDS 1 // shared buffers readings are spread over by sensor id, each with its own datamgr and storagemgr thread
+	#endif
+
+	#define NUM_THREADS (2*SBUFFER_SHARDS+1)
+
+	#define THREAD_SUCCESS 0
+	#define THREAD_ERR_FILEIO 1
+
+	#define DATAMGR_FILE_PARSE_ERROR 2
+	#define DATAMGR_INTERRUPTED_BY_STORAGEMGR 3
+
+	#define CONNMGR_INCORRECT_PORT 4
+	#define CONNMGR_SERVER_OPEN_ERROR 5
+	#define CONNMGR_SERVER_CLOSE_ERROR 6
+	#define CONNMGR_SERVER_CONNECTION_ERROR 7
+	#define CONNMGR_SERVER_POLL_ERROR 8
+	#define CONNMGR_INTERRUPTED_BY_STORAGEMGR 9
+
+	#define STORAGEMGR_COMMIT_ERROR 10
+#endif
+
+typedef uint16_t sensor_id_t;
+typedef double sensor_value_t;     
+typedef time_t sensor_ts_t;         // UTC timestamp as returned by time() - notice that the size of time_t is different on 32/64 bit machine
+
+typedef struct{
+	sensor_id_t id;
+	sensor_value_t value;
+	sensor_ts_t ts;
+} sensor_data_t;
+
+/**
+ * Sensors registered in room_sensor.map, one bit per sensor id. The gateway loads it before its
+ * threads start, afterwards connmgr rewrites it word by word when told to re-read the map
+ **/
+#define SENSOR_MAP_WORDS ((((size_t) 1) << (8*sizeof(sensor_id_t)))/64)
+#define SENSOR_MAP_HAS(map, id) ((atomic_load_explicit(&((map)[(id)/64]), memory_order_relaxed) >> ((id)%64)) & 1)
+
+/**
+ * Wire protocol between sensor_node and the gateway, every field in host byte order without padding
+ * v1: unframed readings <sensor_id><value><timestamp>, PROTO_V1_READING_SIZE bytes each
+ * v2: the node opens with a hello <PROTO_MAGIC><version>, the gateway answers with a hello carrying
+ *     the version both speak. Frames follow, <length><encoding><sensor_id><count><base_ts> and
+ *     'count' readings <value><ts_delta>, 'length' counts the bytes after itself and the timestamp
+ *     of a reading is base_ts + ts_delta
+ * v3: as v2, frames may also use the compressed encodings, see sensor_proto.h
+ * A v1 stream never starts with PROTO_MAGIC, so the gateway tells both apart by the first bytes
+ **/
+#define PROTO_MAGIC 0xFFFF		// sensor id reserved for the hello
+#define PROTO_V1 1
+#define PROTO_V2 2
+#define PROTO_V3 3
+#define PROTO_VERSION PROTO_V3	// highest version spoken by this build
+#define PROTO_ENC_RAW 0			// readings of a frame as <value (sensor_value_t)><ts_delta (int32_t)>
+#define PROTO_ENC_XOR 1			// <zig-zag varint ts - previous ts><value XOR previous value>, lossless (v3)
+#define PROTO_ENC_FIXED 2		// <zig-zag varint ts - previous ts><zig-zag varint value - previous value in 1/PROTO_FIXED_SCALE> (v3)
+#define PROTO_FIXED_SCALE 100	// values of PROTO_ENC_FIXED frames are rounded to 1/PROTO_FIXED_SCALE
+#define PROTO_V1_READING_SIZE (sizeof(sensor_id_t) + sizeof(sensor_value_t) + sizeof(sensor_ts_t))
+#define PROTO_HELLO_SIZE (sizeof(uint16_t) + sizeof(uint8_t))
+#define PROTO_HEADER_SIZE (sizeof(uint16_t) + sizeof(uint8_t) + sizeof(sensor_id_t) + sizeof(uint16_t) + sizeof(sensor_ts_t))
+#define PROTO_RAW_READING_SIZE (sizeof(sensor_value_t) + sizeof(int32_t))
+#define PROTO_MAX_READING_SIZE 20	// bytes of one reading in the largest encoding
+#define PROTO_FRAME_MAX 255		// max. number of readings in one frame
+#define PROTO_FRAME_SIZE 4096	// max. bytes of one frame with its length field, the gateway holds this much per connection
+
+#define CONNMGR_NO_SENSOR -1 // sensor of connmgr commands that are not about one sensor
+
+/**
+ * Flags shared between the threads are atomics, the thread changing one of them signals the
+ * control eventfd ('ctl_event_fd') afterwards so that connmgr's poll loop notices right away
+ **/
+typedef struct {
+	pthread_mutex_t * pipe_mutex;
+	pthread_mutex_t * stdio_mutex;
+	atomic_int * sbuffer_flag;
+	int * ipc_pipe_fd;
+	int * status;
+	int id;
+} storagemgr_init_arg_t;
+
+typedef struct {
+	pthread_mutex_t * pipe_mutex;
+	pthread_mutex_t * stdio_mutex;
+	atomic_int * sbuffer_flag;
+	atomic_int * storagemgr_fail_flag;
+	int * ipc_pipe_fd;
+	int * status;
+	int id;
+} datamgr_init_arg_t;
+
+typedef struct {
+	pthread_mutex_t * pipe_mutex;
+	pthread_mutex_t * stdio_mutex;
+	atomic_int * sbuffer_flag;
+	atomic_int * storagemgr_fail_flag;
+	_Atomic uint64_t * sensor_map;	// SENSOR_MAP_WORDS words, connections of other sensors are refused
+	int * ctl_event_fd;
+	int * ipc_pipe_fd;
+	int * status;
+} connmgr_init_arg_t;
+			
 #endif /* _CONFIG_H_ */
\ No newline at end of file
@@ -13,6 +13,76 @@
  *                              07/01/2020      1.0           Completed, when signalled by Data Manager
  *                                                            connection to non-existing sensor is 
  *                                                            dropped
+ *                              16/10/2026      1.1           Readings of one poll wakeup are inserted
+ *                                                            in the shared buffer as one batch
+ *                                                            Readers parked on the buffer are woken
+ *                                                            up when it is closed
+ *                              16/10/2026      1.2           Sensors are no longer read while the
+ *                                                            shared buffer is above its high-water
+ *                                                            mark, so TCP flow control throttles them
+ *                              16/10/2026      1.3           Readings are spread over the shards of
+ *                                                            the shared buffer by sensor id
+ *                              16/10/2026      1.4           No pausing with the spill policy
+ *                              16/10/2026      1.5           Shared flags are atomics, changes are
+ *                                                            signalled on an eventfd polled next to
+ *                                                            the server socket. Drop requests no
+ *                                                            longer match connections that did not
+ *                                                            send a reading yet
+ *                              16/10/2026      1.6           Edge-triggered epoll backend next to the
+ *                                                            poll loop (CONNMGR_BACKEND), connections
+ *                                                            are reached through the epoll user data
+ *                                                            and kept in intrusive lists, so
+ *                                                            registration and removal are O(1)
+ *                              16/10/2026      1.7           Connections are kept in a table indexed
+ *                                                            by socket descriptor instead of a dplist,
+ *                                                            poll_fds grows by doubling and removal
+ *                                                            moves the last descriptor into the gap
+ *                              16/10/2026      1.8           Idle connections are timed out by a timer
+ *                                                            wheel that also sets the poll timeout,
+ *                                                            the clock is read once per wakeup
+ *                              16/10/2026      1.9           Sockets are non-blocking and read into a
+ *                                                            per-connection buffer with one recv, all
+ *                                                            complete readings are decoded from it and
+ *                                                            a partial one is kept for the next recv
+ *                              16/10/2026      2.0           CONNMGR_WORKERS threads, each with its own
+ *                                                            SO_REUSEPORT listening socket, event loop
+ *                                                            and connections, insert concurrently.
+ *                                                            The worker that takes a control event
+ *                                                            passes it on to the others
+ *                              16/10/2026      2.1           io_uring backend (CONNMGR_BACKEND_URING)
+ *                                                            with multishot accept and receive into
+ *                                                            provided buffers, completions are taken
+ *                                                            in batches. Falls back to the poll loop
+ *                                                            when the kernel lacks io_uring
+ *                              16/10/2026      2.2           Protocol v2, a node that opens with a
+ *                                                            hello sends frames of readings, nodes
+ *                                                            without one are decoded as before
+ *                              16/10/2026      2.3           Frames of v3 nodes may carry compressed
+ *                                                            readings, decoded by sensor_proto
+ *                              16/10/2026      2.4           Readings are decoded straight into slots
+ *                                                            reserved in the shards of the shared
+ *                                                            buffer instead of a batch on the stack.
+ *                                                            A worker keeps its reservations for the
+ *                                                            whole wakeup unless another one waits
+ *                              16/10/2026      2.5           Sensors missing from room_sensor.map are
+ *                                                            refused on their first reading or frame,
+ *                                                            before anything reaches the shared buffer
+ *                              16/10/2026      2.6           Other threads reach the workers through a
+ *                                                            lock-free command queue per worker instead
+ *                                                            of a single drop slot, commands drop or
+ *                                                            throttle a sensor or re-read the sensor
+ *                                                            map. Connections are indexed by sensor id
+ *                              16/10/2026      2.7           Backpressure checks read the lock-free
+ *                                                            sbuffer_shard_depth, water marks are
+ *                                                            taken once in connmgr_listen
+ *                              16/10/2026      2.8           Idle shutdown is decided once for all
+ *                                                            workers, after TIMEOUT without a
+ *                                                            connection on any of them, the workers
+ *                                                            then leave their loops together
+ *                              16/10/2026      2.9           A frame is checked whole before any of its
+ *                                                            readings is decoded into the shared
+ *                                                            buffer, readings the buffer refused to
+ *                                                            reserve for are counted
  *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
  * TODO                         Date            Finished      Comment
  *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -43,320 +113,1555 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <string.h>
+#include <errno.h>
 #include <inttypes.h>
 #include <sys/types.h>
+#include <sys/socket.h>
 #include <poll.h>
 #include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include "config.h"
 #include "connmgr.h"
+#include "connmgr_timer.h"
+#include "connmgr_queue.h"
+#include "sensor_proto.h"
+#if (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+#include "connmgr_uring.h"
+#endif
 #include "lib/tcpsock.h"
-#include "lib/dplist.h"
+
+#if (CONNMGR_RX_BUFFER < PROTO_FRAME_SIZE)
+#error CONNMGR_RX_BUFFER must hold the largest frame
+#endif
+
+#define FIRST_CLIENT 3 // poll_fds[0] is the server socket, poll_fds[1] the control eventfd, poll_fds[2] the eventfd of the worker
+#define CONNMGR_STOP -2 // returned by handle_control_event when storagemgr failed and the event loop has to end
+#define CONNMGR_REFUSED -3 // returned by the decoders for readings of a sensor that is not in the sensor map
+#define READING_SIZE PROTO_V1_READING_SIZE // bytes of one v1 reading on the wire, frames of v2 hold about as many bytes per reading
+#if (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+#define URING_ACCEPT 1  // user data of the multishot accept, receives carry the address of their client_t
+#define URING_CONTROL 2 // multishot poll on the control eventfd
+#define URING_WORKER 3  // multishot poll on the eventfd of the worker
+#define URING_CANCEL 4  // cancellations, their completions are of no interest
+#define URING_IDLE 0    // states of the multishot accept
+#define URING_ARMED 1
+#define URING_CANCELLED 2
+#endif
 
 /**
  * Custom Types
  **/
-struct tcpsock_dpl_el {     // Custom element to use with my dplist implementation to be able to use compare() call
-    tcpsock_t * sock_ptr;   // to and create dummy to compare with (tcpsock_t is incomplete data type otherwise, hence
-    int sd;                 // can't create a dummy with a given sd to use in compare())
-    sensor_ts_t last_active;
+typedef struct client client_t;
+
+struct client {             // One sensor connection, found by its socket descriptor in the connection table
+    tcpsock_t * sock_ptr;
+    int sd;
+    uint64_t last_active;   // monotonic ms of the last reading, the timer is only moved to match it once it fires
+    uint64_t throttled_until; // monotonic ms reading resumes at, 0 while the sensor is not throttled
+    connmgr_timer_t timer;  // idle deadline on the timer wheel, the end of the throttle while throttled
     sensor_id_t sensor;
+    int proto;              // PROTO_V1 or PROTO_V2 once the first bytes were received, 0 before
+    #if (CONNMGR_BACKEND != CONNMGR_BACKEND_EPOLL)
+    int idx;                // position in poll_fds
+    #endif
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_EPOLL)
+    client_t * prev, * next;               // all connections
+    client_t * ready_prev, * ready_next;   // connections with unread data, epoll does not report them again
+    int ready;
+    int hangup;             // peer closed its end, whatever it sent before is still read
+    #endif
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+    int armed;              // multishot receive in flight
+    int closing;            // closed already, freed once the kernel ended the receive
+    #endif
+    int rx_len;             // bytes of a partial reading waiting in rx_buf for the rest
+    unsigned char rx_buf[CONNMGR_RX_BUFFER];
 };
 
+#if (CONNMGR_BACKEND == CONNMGR_BACKEND_EPOLL)
+typedef struct {
+    client_t * first, * last;
+} client_list_t;
+#endif
+
+typedef struct {            // Slots reserved in one shard of the shared buffer, readings are decoded straight into them
+    sensor_data_t * slots;
+    int reserved;           // 0 while nothing is reserved, the shard is held by this worker otherwise
+    int used;
+} reservation_t;
+
+typedef struct {            // One event loop thread, owns the connections the kernel hands to its listening socket
+    pthread_t thread;
+    int efd;                // control events passed on by the worker that took them from the control eventfd
+    connmgr_queue_t commands; // see connmgr_command, popped by the worker on every wakeup
+    int status;
+    int insertions;
+    int dropped;            // readings lost because the shared buffer refused to reserve slots for them
+} connmgr_worker_t;
+
 /**
  * Private Prototypes
  **/
 //
-static void * socket_copy(void * element);
-static void socket_free(void ** element);
-static int socket_compare(void * x, void * y);
+static void * worker_thread(void * arg);
+static void worker_listen(int port_number, sbuffer_shard_t * buffer);
+static int worker_free(void);
+static void socket_free(client_t * client);
+static int table_insert(client_t * client);
+#if (CONNMGR_BACKEND != CONNMGR_BACKEND_EPOLL)
+static client_t * table_lookup(int sd);
+#endif
+static void table_remove(int sd);
+static client_t * accept_client(void);
+static client_t * client_create(tcpsock_t * sock, int sd);
+static int decode_readings(client_t * client, unsigned char * data, int len, sbuffer_shard_t * buffer, int * sbuffer_insertions);
+static int decode_v1(client_t * client, unsigned char * data, int len, sbuffer_shard_t * buffer, int * sbuffer_insertions);
+static int decode_frames(client_t * client, unsigned char * data, int len, sbuffer_shard_t * buffer, int * sbuffer_insertions);
+static int frame_valid(proto_codec_t codec, const unsigned char * field, int left, int count);
+static int answer_hello(client_t * client, uint8_t version);
+static int accept_sensor(client_t * client, sensor_id_t id);
+static void push_reading(reservation_t * batch);
+static reservation_t * reserve_slot(sbuffer_shard_t * buffer, int shard, int * sbuffer_insertions);
+static int commit_reservation(sbuffer_shard_t * buffer, int shard);
+static ssize_t receive_readings(client_t * client, sbuffer_shard_t * buffer, int * sbuffer_insertions);
+static int handle_control_event(void);
+static int idle_timeout(void);
+static int idle_shutdown(void);
+static void run_commands(int * conn_counter);
+static void sweep_clients(int * conn_counter);
+static void drop_client(client_t * client, int * conn_counter);
+static void throttle_client(client_t * client, int ms);
+static void resume_client(client_t * client);
+static int sensor_insert(client_t * client);
+static client_t * sensor_lookup(int sensor);
+static int flush_batch(sbuffer_shard_t * buffer);
+static int check_backpressure(sbuffer_shard_t * buffer, int paused);
+static client_t * expire_idle_client(void);
+#if (CONNMGR_BACKEND == CONNMGR_BACKEND_EPOLL)
+static int epoll_loop(sbuffer_shard_t * buffer, int * sbuffer_insertions);
+static int service_client(client_t * client, sbuffer_shard_t * buffer, int * sbuffer_insertions);
+static void close_client(client_t * client);
+static void mark_ready(client_t * client);
+static void unmark_ready(client_t * client);
+#else
+static int poll_loop(sbuffer_shard_t * buffer, int * sbuffer_insertions);
+static void poll_remove(int i, int * conn_counter);
+#endif
+#if (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+static int uring_loop(sbuffer_shard_t * buffer, int * sbuffer_insertions);
+static int uring_receive(client_t * client, unsigned char * data, int len, sbuffer_shard_t * buffer, int * sbuffer_insertions);
+static void uring_close(client_t * client, int * conn_counter);
+#endif
 
 /**
  * Global Variables
  **/
-static dplist_t * socket_list;
-static tcpsock_t * server;
-static struct pollfd * poll_fds;
-static pthread_rwlock_t * sbuffer_open_rwlock;
+static sbuffer_shard_t * shared_buffer;
 static pthread_mutex_t * ipc_pipe_mutex;
-static pthread_rwlock_t * storagemgr_failed_rwlock;
-static pthread_mutex_t * connmgr_drop_conn_mutex;
-static sensor_id_t * connmgr_sensor_to_drop;
-static int * storagemgr_fail_flag;
-static int * sbuffer_open;
-static int * retval;
+static atomic_int * storagemgr_fail_flag;
+static atomic_int * sbuffer_open;
+static _Atomic uint64_t * sensor_map;
+static int * ctl_efd;
+static _Atomic(int *) command_efd = NULL; // control eventfd as seen by the threads calling connmgr_command, NULL before connmgr_init
 static int * pfds;
+static int listen_port;
+static size_t high_water, low_water; // of the fullest shard, see check_backpressure
+static connmgr_worker_t workers[CONNMGR_WORKERS]; // workers[0] runs on the thread that called connmgr_listen
+static atomic_int open_connections;    // in the connection tables of all workers
+static _Atomic uint64_t idle_since;    // monotonic ms of the last close, or of the start, only meaningful while open_connections is 0
+static atomic_int idle_stop;           // set by the worker that decided connmgr has been idle for TIMEOUT, the others follow it
+
+// state of the event loop, every worker has its own
+static _Thread_local int worker;
+static _Thread_local int * retval;                 // status of the worker, of the connmgr thread for workers[0]
+static _Thread_local client_t ** conn_table;      // indexed by socket descriptor, NULL where no connection is open
+static _Thread_local int conn_table_size;
+static _Thread_local client_t ** sensor_table;    // indexed by sensor id, the latest connection of the sensor
+static _Thread_local int sensor_table_size;
+static _Thread_local tcpsock_t * server;
+static _Thread_local struct pollfd * poll_fds;
+static _Thread_local connmgr_wheel_t idle_timers; // one timer per connection, due at TIMEOUT after its last reading
+static _Thread_local uint64_t loop_now;           // monotonic ms, read once per wakeup
+static _Thread_local reservation_t reservations[SBUFFER_SHARDS]; // committed at the end of every wakeup, or earlier when full or wanted by another worker
+#if (CONNMGR_BACKEND == CONNMGR_BACKEND_EPOLL)
+static _Thread_local int epoll_fd = -1;
+static _Thread_local client_list_t clients;       // O(1) insertion and removal, walked only for timeouts, drops and clean up
+static _Thread_local client_list_t ready_clients; // served round-robin, CONNMGR_READ_BUDGET readings at a time
+static _Thread_local int conn_counter;
+#endif
+#if (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+static _Thread_local connmgr_uring_t ring = { .fd = -1 }; // fd stays -1 if io_uring is not available and the poll loop runs instead
+#endif
 
 /**
  * Functions
  **/
-// 
+//
 void connmgr_init(connmgr_init_arg_t * arg)
 {
-    sbuffer_open_rwlock = arg->sbuffer_rwlock;
     sbuffer_open = arg->sbuffer_flag;
     retval = arg->status;
     ipc_pipe_mutex = arg->pipe_mutex;
     pfds = arg->ipc_pipe_fd;
-    storagemgr_failed_rwlock = arg->storagemgr_failed_rwlock;
     storagemgr_fail_flag = arg->storagemgr_fail_flag;
-    connmgr_drop_conn_mutex = arg->connmgr_drop_conn_mutex;
-    connmgr_sensor_to_drop = arg->connmgr_sensor_to_drop;
+    sensor_map = arg->sensor_map;
+    ctl_efd = arg->ctl_event_fd;
+    atomic_store(&command_efd, ctl_efd);
+}
+
+int connmgr_command(int type, int sensor, int arg)
+{
+    connmgr_cmd_t cmd = { .type = type, .sensor = sensor, .arg = arg };
+    int res = CONNMGR_QUEUE_SUCCESS;
+    int * efd = atomic_load(&command_efd);
+
+    if(type == CONNMGR_CMD_RELOAD) res = connmgr_queue_push(&(workers[0].commands), &cmd); // the map is read once, worker 0 has the others check their connections
+    else for(int w = 0; w < CONNMGR_WORKERS; w++) // it is not known which worker holds the sensor, the others find no connection in their index
+    {
+        if(connmgr_queue_push(&(workers[w].commands), &cmd) != CONNMGR_QUEUE_SUCCESS) res = CONNMGR_QUEUE_FULL;
+    }
+    if(efd != NULL) write_to_event(efd); // the worker that takes it wakes up the others
+
+    return (res == CONNMGR_QUEUE_SUCCESS) ? 0 : -1;
+}
+
+int connmgr_load_sensor_map(_Atomic uint64_t * map)
+{
+    uint64_t loaded[SENSOR_MAP_WORDS] = {0};
+    char line[11]; // as datamgr parses the map
+    uint16_t room;
+    sensor_id_t id;
+    FILE * fp_sensor_map = fopen("room_sensor.map", "r");
+    if(fp_sensor_map == NULL) return -1;
+
+    while(fgets(line, sizeof(line), fp_sensor_map) != NULL)
+    {
+        if(sscanf(line, "%hu%hu", &room, &id) == 2) loaded[id/64] |= (uint64_t) 1 << (id%64);
+    }
+    int failed = ferror(fp_sensor_map);
+    fclose(fp_sensor_map);
+    if(failed) return -1;
+
+    for(size_t i = 0; i < SENSOR_MAP_WORDS; i++) atomic_store_explicit(&(map[i]), loaded[i], memory_order_relaxed); // a word at a time, a sensor is either in or out
+
+    return 0;
 }
 
-void connmgr_listen(int port_number, sbuffer_t ** buffer)
+void connmgr_listen(int port_number, sbuffer_shard_t * buffer)
 {
     char * send_buf;
+    int sbuffer_insertions = 0, sbuffer_drops = 0, started = 1;
+    shared_buffer = buffer; // kept to wake up the readers when the buffer is closed in connmgr_free
+    sbuffer_stats_t stats;
+    sbuffer_shard_get_stats(buffer, &stats); // water marks do not change, only the depth is polled later on
+    high_water = stats.high_water;
+    low_water = stats.low_water;
+    worker = 0;
 
-    if(port_number < MIN_PORT || port_number > MAX_PORT) 
+    if(port_number < MIN_PORT || port_number > MAX_PORT)
     {
         asprintf(&send_buf, "%ld Connection Manager: invalid PORT", time(NULL));
         write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
 
-        *retval = CONNMGR_INCORRECT_PORT; 
+        *retval = CONNMGR_INCORRECT_PORT;
         poll_fds = NULL; // set pointers to NULL to avoid freeing unallocated space in call to 'free' (initial value may not be NULL)
-        socket_list = NULL;
+        conn_table = NULL;
         server = NULL;
 
         return;
     }
 
-    socket_list = dpl_create(&socket_copy, &socket_free, &socket_compare);
-    poll_fds = (struct pollfd *) malloc(sizeof(struct pollfd)); // Initially array for 1 element
+    atomic_store(&open_connections, 0);
+    atomic_store(&idle_since, connmgr_clock_ms());
+    atomic_store(&idle_stop, 0);
+    for(int w = 0; w < CONNMGR_WORKERS; w++)
+    {
+        workers[w].efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        workers[w].status = THREAD_SUCCESS;
+        workers[w].insertions = 0;
+        workers[w].dropped = 0;
+    }
+    listen_port = port_number;
+    for(; started < CONNMGR_WORKERS; started++) // the other workers open their own listening socket on the same port
+    {
+        if(pthread_create(&(workers[started].thread), NULL, &worker_thread, &(workers[started])) != 0) break;
+    }
+
+    worker_listen(port_number, buffer);
+    sbuffer_insertions = workers[0].insertions;
+    sbuffer_drops = workers[0].dropped;
+
+    for(int w = 1; w < started; w++)
+    {
+        pthread_join(workers[w].thread, NULL);
+        sbuffer_insertions += workers[w].insertions;
+        sbuffer_drops += workers[w].dropped;
+        if(*retval == THREAD_SUCCESS) *retval = workers[w].status; // the first failing worker decides the status of connmgr
+    }
+    for(int w = 0; w < CONNMGR_WORKERS; w++)
+    {
+        if(workers[w].efd != -1) close(workers[w].efd);
+        workers[w].efd = -1;
+    }
+
+    #if (DEBUG_LVL > 0)
+    printf("Connection Manager: total %d messages processed during session by %d workers, %d not reserved for\n", sbuffer_insertions, started, sbuffer_drops);
+    fflush(stdout);
+    #endif
+}
+
+void connmgr_free()
+{
+    char * send_buf;
+
+    if(worker_free() != TCP_NO_ERROR) // the other workers cleaned up before connmgr_listen returned
+    {
+        *retval = CONNMGR_SERVER_CLOSE_ERROR; // close master socket if any
+
+        asprintf(&send_buf, "%ld Connection Manager: failed to stop", time(NULL));
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+    } else
+    {
+        asprintf(&send_buf, "%ld Connection Manager: stopped successfully", time(NULL));
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+    }
+    if(shared_buffer != NULL)
+    {
+        sbuffer_stats_t stats;
+        sbuffer_shard_get_stats(shared_buffer, &stats);
+        asprintf(&send_buf, "%ld Shared buffer: %s policy, %lu readings dropped", time(NULL), sbuffer_policy_name(stats.policy), stats.dropped);
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+    }
+
+    #if (DEBUG_LVL > 0)
+    printf("Server is shutting down. Closing shared buffer\n");
+    fflush(stdout);
+    #endif
+    atomic_store_explicit(sbuffer_open, 0, memory_order_release); // indicate reader threads the end of buffer, all readings were inserted before
+    if(shared_buffer != NULL) sbuffer_shard_wakeup(shared_buffer); // readers parked on an empty buffer re-check the flag right away
+}
+
+static void * worker_thread(void * arg)
+{
+    worker = (int) ((connmgr_worker_t *) arg - workers);
+    retval = &(workers[worker].status);
+
+    worker_listen(listen_port, shared_buffer);
+    if(worker_free() != TCP_NO_ERROR) *retval = CONNMGR_SERVER_CLOSE_ERROR;
+
+    return NULL;
+}
+
+// Opens the listening socket of the calling worker and runs its event loop until connmgr as a whole times out without connections
+static void worker_listen(int port_number, sbuffer_shard_t * buffer)
+{
+    char * send_buf;
+
+    conn_table = NULL;
+    conn_table_size = 0;
+    sensor_table = NULL;
+    sensor_table_size = 0;
+    server = NULL;
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_EPOLL)
+    poll_fds = NULL;
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    #else
+    poll_fds = (struct pollfd *) malloc(sizeof(struct pollfd)*FIRST_CLIENT); // Initially array for the server socket and control events
+    #endif
 
-    if(tcp_passive_open(&(server), port_number) != TCP_NO_ERROR) 
+    #if (CONNMGR_WORKERS > 1)
+    int tcp_res = tcp_passive_open_shared(&(server), port_number); // every worker listens on the port, the kernel spreads connections over them
+    #else
+    int tcp_res = tcp_passive_open(&(server), port_number);
+    #endif
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_EPOLL)
+    if(epoll_fd == -1 || workers[worker].efd == -1 || tcp_res != TCP_NO_ERROR)
+    #else
+    if(poll_fds == NULL || workers[worker].efd == -1 || tcp_res != TCP_NO_ERROR)
+    #endif
     {
-        *retval = CONNMGR_SERVER_OPEN_ERROR; // her setting poll_fds and socket_list to NULL is not needed as it was allocated already
-        
+        *retval = CONNMGR_SERVER_OPEN_ERROR; // her setting poll_fds to NULL is not needed as it was allocated already
+
         asprintf(&send_buf, "%ld Connection Manager: failed to start", time(NULL));
         write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
-        
+
         return;
     }
 
     asprintf(&send_buf, "%ld Connection Manager: started successfully", time(NULL));
     write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
 
-    tcp_get_sd(server, &(poll_fds[0].fd)); // Set socket file descriptor to poll elements
-    poll_fds[0].events = POLLIN; // Choose poll events
-    
-    struct tcpsock_dpl_el * client;
-    struct tcpsock_dpl_el dummy;
-    dplist_node_t * node;
-    int conn_counter = 0, sbuffer_insertions = 0;
-    sensor_data_t data;
-    int bytes, tcp_res, tcp_conn_res, poll_res, sbuffer_res;
-
-    while((poll_res = poll(poll_fds, (conn_counter+1), TIMEOUT*1000)) || conn_counter) // Repeat until poll times-out after no connections are left
-    {
-        pthread_rwlock_rdlock(storagemgr_failed_rwlock); // putting inside the loop does not force storagemgr to hang until poll elapses TIMEOUT seconds
-        if(*storagemgr_fail_flag)                  // connmgr instead treats the signal asynchronously whenever it is done polling
-        {
-            pthread_rwlock_unlock(storagemgr_failed_rwlock);
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+    if(connmgr_uring_init(&ring, CONNMGR_URING_ENTRIES, CONNMGR_URING_BUFFERS, CONNMGR_URING_BUFFER_SIZE) != CONNMGR_URING_SUCCESS)
+    {
+        asprintf(&send_buf, "%ld Connection Manager: io_uring not supported, polling instead", time(NULL));
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+    }
+    #endif
+
+    loop_now = connmgr_clock_ms();
+    connmgr_wheel_init(&idle_timers, loop_now);
+
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_EPOLL)
+    int res = epoll_loop(buffer, &(workers[worker].insertions));
+    #elif (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+    int res = (ring.fd != -1) ? uring_loop(buffer, &(workers[worker].insertions)) : poll_loop(buffer, &(workers[worker].insertions));
+    #else
+    int res = poll_loop(buffer, &(workers[worker].insertions));
+    #endif
+    workers[worker].insertions += flush_batch(buffer); // the loop may have ended halfway through a wakeup, the shards are handed back
+
+    if(res == -1)
+    {
+        *retval = CONNMGR_SERVER_POLL_ERROR;
+
+        asprintf(&send_buf, "%ld Connection Manager: error polling sockets", time(NULL));
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+    }
+}
 
-            *retval = CONNMGR_INTERRUPTED_BY_STORAGEMGR;
+// Closes the listening socket and the connections of the calling worker, returns the result of closing the listening socket
+static int worker_free(void)
+{
+    int res = (server != NULL) ? tcp_close(&server) : TCP_NO_ERROR;
+
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+    connmgr_uring_free(&ring); // ends the receives still in flight before their connections are freed
+    #endif
+    if(poll_fds != NULL) free(poll_fds); // Clean up allocated socket descriptor array if any
+    poll_fds = NULL;
+    for(int sd = 0; sd < conn_table_size; sd++) // Close and free open connections if any, closing the descriptors takes them out of the epoll set as well
+    {
+        if(conn_table[sd] != NULL) socket_free(conn_table[sd]);
+        table_remove(sd);
+    }
+    free(conn_table);
+    conn_table = NULL;
+    conn_table_size = 0;
+    free(sensor_table);
+    sensor_table = NULL;
+    sensor_table_size = 0;
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_EPOLL)
+    clients.first = clients.last = NULL;
+    ready_clients.first = ready_clients.last = NULL;
+    if(epoll_fd != -1) close(epoll_fd);
+    epoll_fd = -1;
+    #endif
 
-            asprintf(&send_buf, "%ld Connection Manager: signalled to terminate by Storage Manager", time(NULL));
-            write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+    return res;
+}
 
-            connmgr_free();
+#if (CONNMGR_BACKEND == CONNMGR_BACKEND_EPOLL)
+// Event loop on an edge-triggered epoll set, ready connections come back through the epoll user data
+static int epoll_loop(sbuffer_shard_t * buffer, int * sbuffer_insertions)
+{
+    struct epoll_event events[CONNMGR_EPOLL_EVENTS];
+    struct epoll_event event = {0};
+    client_t * client, * next;
+    int server_sd, epoll_res;
+    int paused = 0; // set while the shared buffer is above its high-water mark
+    int listening = 1; // server socket is taken out of the set while MAX_CONN connections are open
 
-            #if (DEBUG_LVL > 0)
-            printf("Connection Manager is stopped\n");
-            fflush(stdout);
-            #endif
+    conn_counter = 0;
+    tcp_get_sd(server, &server_sd);
+    fcntl(server_sd, F_SETFL, fcntl(server_sd, F_GETFL) | O_NONBLOCK); // accept until the backlog is empty
+    event.events = EPOLLIN; // level-triggered, pending connections are reported until accepted
+    event.data.ptr = &server;
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_sd, &event) == -1) return -1;
+    event.data.ptr = ctl_efd;
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, *ctl_efd, &event) == -1) return -1;
+    event.data.ptr = &(workers[worker].efd);
+    if(epoll_ctl(epoll_fd, EPOLL_CTL_ADD, workers[worker].efd, &event) == -1) return -1;
 
-            pthread_exit(retval);
+    while(1)
+    {
+        int timeout = (ready_clients.first != NULL && !paused) ? 0 : (paused && conn_counter) ? CONNMGR_BACKPRESSURE_POLL : conn_counter ? connmgr_wheel_timeout(&idle_timers, connmgr_clock_ms()) : idle_timeout(); // wake up when the next idle connection is due
+        if((epoll_res = epoll_wait(epoll_fd, events, CONNMGR_EPOLL_EVENTS, timeout)) == 0 && conn_counter == 0 && idle_shutdown()) break; // Repeat until epoll times out after no connections are left on any worker
+        if(epoll_res == -1)
+        {
+            if(errno == EINTR) continue;
+            return -1;
         }
-        pthread_rwlock_unlock(storagemgr_failed_rwlock);
+        loop_now = connmgr_clock_ms();
 
-        if(poll_res == -1) break;
-        if((poll_fds[0].revents & POLLIN) && conn_counter < MAX_CONN) // When an event is received from Master socket, create new socket unless limit is reached
+        int incoming = 0;
+        for(int i = 0; i < epoll_res; i++) // only mark what happened, connections are served below in arrival order
         {
-            #if (DEBUG_LVL > 1)
-            printf("Incoming client connection\n");
-            fflush(stdout);
-            #endif
-
-            client = (struct tcpsock_dpl_el *) malloc(sizeof(struct tcpsock_dpl_el));
-            
-            if((tcp_conn_res = tcp_wait_for_connection(server, &(client->sock_ptr))) != TCP_NO_ERROR) // Blocks until a connection is processed
+            if(events[i].data.ptr == &server) incoming = 1;
+            else if(events[i].data.ptr == ctl_efd || events[i].data.ptr == &(workers[worker].efd))
             {
-                *retval = CONNMGR_SERVER_CONNECTION_ERROR;
+                if(handle_control_event() == CONNMGR_STOP) return 0;
+            }
+            else
+            {
+                client = (client_t *) events[i].data.ptr;
+                if(events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) client->hangup = 1;
+                if(client->throttled_until == 0) mark_ready(client); // marked once the throttle ends, the data waits in the socket
+            }
+        }
 
-                asprintf(&send_buf, "%ld Connection Manager: failed to accept new connection (%d)", time(NULL), tcp_conn_res);
-                write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
-            } else
+        while(incoming && conn_counter < MAX_CONN && (client = accept_client()) != NULL) // When an event is received from Master socket, create new sockets unless limit is reached
+        {
+            event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+            event.data.ptr = client;
+            if(table_insert(client) == -1 || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client->sd, &event) == -1)
             {
-                conn_counter++; // Increment number of connections
-                poll_fds = (struct pollfd *) realloc(poll_fds, sizeof(struct pollfd)*(conn_counter+1)); // Increase poll_fd array size
-                tcp_get_sd(client->sock_ptr, &(poll_fds[conn_counter].fd)); // Set socket file descriptor to poll elements
-                client->sd = poll_fds[conn_counter].fd;
-                client->last_active = (sensor_ts_t) time(NULL);
-                client->sensor = 0;
-                poll_fds[conn_counter].events = POLLIN | POLLHUP; // Choose poll events
-                dpl_insert_sorted(socket_list, client, false); // Insert connection into dplist
-                
-                asprintf(&send_buf, "%ld Connection Manager: new connection received", time(NULL));
-                write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+                table_remove(client->sd);
+                socket_free(client);
+                continue;
+            }
+            client->prev = clients.last;
+            client->next = NULL;
+            client->ready = client->hangup = 0;
+            if(clients.last != NULL) clients.last->next = client;
+            else clients.first = client;
+            clients.last = client;
+            conn_counter++;
+        }
+        if(listening != (conn_counter < MAX_CONN)) // stop the level-triggered server socket from firing while no connection can be taken
+        {
+            listening = !listening;
+            event.events = listening ? EPOLLIN : 0;
+            event.data.ptr = &server;
+            epoll_ctl(epoll_fd, EPOLL_CTL_MOD, server_sd, &event);
+        }
 
-                #if (DEBUG_LVL > 0)
-                printf("\n##### Printing Socket DPLIST Content Summary #####\n");
-                dpl_print_heap(socket_list);
-                #endif
+        for(client = paused ? NULL : ready_clients.first; client != NULL; client = next) // unread data stays in the kernel socket buffers while paused
+        {
+            next = client->ready_next;
+            service_client(client, buffer, sbuffer_insertions);
+        }
+
+        run_commands(&conn_counter);
+
+        while(!paused && (client = expire_idle_client()) != NULL) close_client(client); // If connection timed out stop listening to this descriptor, sensors are not timed out while we do not read them
+
+        *sbuffer_insertions += flush_batch(buffer); // publish everything received during this wakeup
+
+        int was_paused = paused;
+        paused = check_backpressure(buffer, paused);
+        for(client = (was_paused && !paused) ? clients.first : NULL; client != NULL; client = client->next) client->last_active = loop_now; // sensors were silent because of us, do not time them out
+    }
+
+    return 0;
+}
+
+// Reads about CONNMGR_READ_BUDGET readings worth of bytes from 'client', keeps it in the ready list while more are waiting
+static int service_client(client_t * client, sbuffer_shard_t * buffer, int * sbuffer_insertions)
+{
+    char * send_buf;
+    int drained = 0, gone = 0;
+
+    for(int budget = CONNMGR_READ_BUDGET*(int) READING_SIZE; budget > 0 && !drained && !gone; )
+    {
+        int space = CONNMGR_RX_BUFFER - client->rx_len;
+        ssize_t received = receive_readings(client, buffer, sbuffer_insertions);
+
+        if(received == -1 && errno == EINTR) continue;
+        if(received == 0 || (received == -1 && errno != EAGAIN && errno != EWOULDBLOCK)) gone = 1; // peer closed the connection or it broke
+        drained = (received < space); // a short read emptied the socket, new data raises a new edge
+        budget -= (int) received;
+    }
+
+    if(!drained && !gone) return 0; // out of budget, the rest is read on the next wakeup
+    if(gone || client->hangup) // nothing left to read from a peer that is gone
+    {
+        asprintf(&send_buf, "%ld Connection Manager: lost connection with", time(NULL));
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+        close_client(client);
+
+        return 1;
+    }
+    unmark_ready(client);
+
+    return 0;
+}
+
+static void close_client(client_t * client)
+{
+    char * send_buf;
+
+    #if (DEBUG_LVL > 1)
+    printf("Peer closed connection or timed out - %d total\n", conn_counter);
+    fflush(stdout);
+    #endif
+
+    asprintf(&send_buf, "%ld Connection Manager: connection to %"PRIu16" closed", time(NULL), client->sensor);
+    write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+
+    unmark_ready(client);
+    if(client->prev != NULL) client->prev->next = client->next;
+    else clients.first = client->next;
+    if(client->next != NULL) client->next->prev = client->prev;
+    else clients.last = client->prev;
+    conn_counter--;
+    table_remove(client->sd);
+    socket_free(client); // closing the descriptor removes it from the epoll set
+}
+
+static void mark_ready(client_t * client)
+{
+    if(client->ready) return;
+
+    client->ready = 1;
+    client->ready_prev = ready_clients.last;
+    client->ready_next = NULL;
+    if(ready_clients.last != NULL) ready_clients.last->ready_next = client;
+    else ready_clients.first = client;
+    ready_clients.last = client;
+}
+
+static void unmark_ready(client_t * client)
+{
+    if(!client->ready) return;
+
+    client->ready = 0;
+    if(client->ready_prev != NULL) client->ready_prev->ready_next = client->ready_next;
+    else ready_clients.first = client->ready_next;
+    if(client->ready_next != NULL) client->ready_next->ready_prev = client->ready_prev;
+    else ready_clients.last = client->ready_prev;
+}
+#else
+static int poll_loop(sbuffer_shard_t * buffer, int * sbuffer_insertions)
+{
+    tcp_get_sd(server, &(poll_fds[0].fd)); // Set socket file descriptor to poll elements
+    poll_fds[0].events = POLLIN; // Choose poll events
+    poll_fds[1].fd = *ctl_efd;
+    poll_fds[1].events = POLLIN;
+    poll_fds[2].fd = workers[worker].efd;
+    poll_fds[2].events = POLLIN;
+
+    char * send_buf;
+    client_t * client;
+    int conn_counter = 0;
+    int poll_fds_size = FIRST_CLIENT; // capacity of poll_fds, doubled when full so connects do not realloc every time
+    int poll_res;
+    int paused = 0; // set while the shared buffer is above its high-water mark
+
+    while((poll_res = poll(poll_fds, (conn_counter+FIRST_CLIENT), (paused && conn_counter) ? CONNMGR_BACKPRESSURE_POLL : conn_counter ? connmgr_wheel_timeout(&idle_timers, connmgr_clock_ms()) : idle_timeout())) || conn_counter || !idle_shutdown()) // Repeat until poll times-out after no connections are left on any worker, wake up when the next idle connection is due
+    {
+        if(poll_res > 0 && ((poll_fds[1].revents | poll_fds[2].revents) & POLLIN)) // flags are only looked at once the control event fired
+        {
+            if(handle_control_event() == CONNMGR_STOP) return 0;
+        }
+
+        if(poll_res == -1)
+        {
+            if(errno == EINTR) continue;
+            break;
+        }
+        loop_now = connmgr_clock_ms();
+        if((poll_fds[0].revents & POLLIN) && conn_counter < MAX_CONN) // When an event is received from Master socket, create new socket unless limit is reached
+        {
+            if((client = accept_client()) != NULL)
+            {
+                if(conn_counter+FIRST_CLIENT == poll_fds_size) // Increase poll_fd array size, in place or not the array is that much bigger now
+                {
+                    struct pollfd * grown = (struct pollfd *) realloc(poll_fds, sizeof(struct pollfd)*poll_fds_size*2);
+                    if(grown != NULL)
+                    {
+                        poll_fds = grown;
+                        poll_fds_size *= 2;
+                    }
+                }
+                if(conn_counter+FIRST_CLIENT == poll_fds_size || table_insert(client) == -1) // no room for its pollfd or no table entry
+                {
+                    socket_free(client);
+                } else
+                {
+                    conn_counter++; // Increment number of connections
+                    client->idx = conn_counter+FIRST_CLIENT-1;
+                    poll_fds[client->idx].fd = client->sd; // Set socket file descriptor to poll elements
+                    poll_fds[client->idx].events = paused ? 0 : (POLLIN | POLLHUP); // Choose poll events, hang-ups are reported regardless
+                    poll_fds[client->idx].revents = 0; // not polled yet, the slot may hold a stale result
+
+                    #if (DEBUG_LVL > 0)
+                    printf("Connection Manager: %d connections open\n", conn_counter);
+                    #endif
+                }
             }
             poll_res--;
         }
 
-        for(int i = 1; i < (conn_counter+1) && poll_res > 0; i++) // poll_res indicates number of structures, stop looping when that number is reached
-        {   
-            dummy.sd = poll_fds[i].fd; // Find corresponding client, based on the sd
-            node = dpl_get_reference_of_element(socket_list, &dummy); // Get corresponding element from dplist
-            client = (node != NULL) ? (struct tcpsock_dpl_el *) dpl_get_element_of_reference(node) : NULL;
-            
-            if(client != NULL && ((client->last_active + (sensor_ts_t) TIMEOUT) > (sensor_ts_t) time(NULL)) && (poll_fds[i].revents & POLLIN)) // If there is data available from client socket and socket is non NULL and has not timed out yet
+        for(int i = FIRST_CLIENT; i < (conn_counter+FIRST_CLIENT) && poll_res > 0; i++) // poll_res indicates number of structures, stop looping when that number is reached
+        {
+            client = table_lookup(poll_fds[i].fd); // Find corresponding client, based on the sd
+
+            if(client != NULL && (poll_fds[i].revents & POLLIN)) // If there is data available from client socket and socket is non NULL
             {
                 #if (DEBUG_LVL > 1)
                 printf("Receiving data from %d peer of %d total\n", i, conn_counter);
                 fflush(stdout);
                 #endif
-                
-                bytes = sizeof(data.id); // read sensor ID
-                tcp_res = tcp_receive(client->sock_ptr, (void *) &data.id, &bytes);
-                bytes = sizeof(data.value); // read temperature
-                tcp_res = tcp_receive(client->sock_ptr, (void *) &data.value, &bytes);
-                bytes = sizeof(data.ts); // read timestamp
-                tcp_res = tcp_receive(client->sock_ptr, (void *) &data.ts, &bytes);
-                
-                if((tcp_res == TCP_NO_ERROR) && bytes) 
-                {
-                    client->last_active = (sensor_ts_t) time(NULL); // Make sure to update last_active only when receiving is successful
-                    if(client->sensor == 0) client->sensor = data.id;
-                    sbuffer_res = sbuffer_insert(*buffer, &data); // sbuffer implementation takes care of thread safety
-
-                    if(sbuffer_res == SBUFFER_SUCCESS) // this block is purely for debugging
-                    {
-                        sbuffer_insertions++;
 
-                        #if (DEBUG_LVL > 1)
-                        printf("Inserted new in shared buffer: %" PRIu16 " %g %ld\n", data.id, data.value, data.ts);
-                        fflush(stdout);
-                        #endif
-                    } else
-                    {
-                        #if (DEBUG_LVL > 1)
-                        printf("Failed to insert in shared buffer: %" PRIu16 " %g %ld\n", data.id, data.value, data.ts);
-                        fflush(stdout);
-                        #endif
-                    }
-                } else if(tcp_res == TCP_CONNECTION_CLOSED) 
+                ssize_t received;
+                do { // whatever is left stays readable for the next poll, unless the peer hung up
+                    received = receive_readings(client, buffer, sbuffer_insertions);
+                } while(received > 0 && (poll_fds[i].revents & POLLHUP));
+                if(received == 0 || (received == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) // peer closed the connection or it broke
                 {
                     poll_fds[i].events = -1;
-                    
+
                     asprintf(&send_buf, "%ld Connection Manager: lost connection with", time(NULL));
                     write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
                 }
             }
 
-            pthread_mutex_lock(connmgr_drop_conn_mutex);
-            if((client != NULL && client->sensor == *connmgr_sensor_to_drop) || (poll_fds[i].revents & POLLHUP) || (poll_fds[i].events == -1) || (client != NULL && ((client->last_active + (sensor_ts_t) TIMEOUT) < (sensor_ts_t) time(NULL))) || client == NULL) // If peer terminated connection or connection timed out for existing socket or no element was found stop listening to this descriptor, remove file descriptor from the list
+            if((poll_fds[i].revents & POLLHUP) || (poll_fds[i].events == -1) || client == NULL) // If peer terminated connection for existing socket or no element was found stop listening to this descriptor, remove file descriptor from the list
             {
-                if(client != NULL && client->sensor == *connmgr_sensor_to_drop) 
-                {
-                    *connmgr_sensor_to_drop = 0;
-                    pthread_mutex_unlock(connmgr_drop_conn_mutex);
+                poll_remove(i, &conn_counter);
+                i--; // Ensures the moved descriptor is looked at as well, it was polled in this round too
+            }
+        }
 
-                    asprintf(&send_buf, "%ld Connection Manager: signalled to drop connection to %"PRIu16, time(NULL), client->sensor);
-                    write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
-                } else pthread_mutex_unlock(connmgr_drop_conn_mutex);
-                
-                #if (DEBUG_LVL > 1)
-                printf("Peer closed connection or timed out - %d of %d\n", i, conn_counter);
-                fflush(stdout);
-                #endif
-                
-                if(client != NULL) 
-                {
-                    asprintf(&send_buf, "%ld Connection Manager: connection to %"PRIu16" closed", time(NULL), client->sensor);
-                    write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
-                    
-                    dpl_remove_node(socket_list, node, true); // Close and remove connection from dplist if element exists
-                }
-                for(int id1 = 0, id2 = 0; id1 < conn_counter; id1++, id2++)
-                {
-                    id2 += (id2 == i) ? 1 : 0; // Skip deleted element
-                    poll_fds[id1] = poll_fds[id2]; // Copy socket descriptors between arrays
-                }
-                poll_fds = realloc(poll_fds, sizeof(struct pollfd)*conn_counter);
-                conn_counter--; // Decrement number of sockets. Decremented after realloc because array contains server socket at index 0, hence new_connections+1 elements for new array
-                i--; // Ensures when an element is removed from poll_fds, incrementation won't skip over the following element
-                
-                #if (DEBUG_LVL > 0)
-                printf("\n##### Printing Socket DPLIST Content Summary #####\n");
-                dpl_print_heap(socket_list);
-                #endif
-            } else pthread_mutex_unlock(connmgr_drop_conn_mutex);
+        run_commands(&conn_counter);
+
+        while(!paused && (client = expire_idle_client()) != NULL) poll_remove(client->idx, &conn_counter); // If connection timed out stop listening to this descriptor, sensors are not timed out while we do not read them
+
+        *sbuffer_insertions += flush_batch(buffer); // publish everything received during this wakeup
+
+        int was_paused = paused;
+        paused = check_backpressure(buffer, paused);
+        if(paused != was_paused) // unread data stays in the kernel socket buffers, TCP flow control stalls the sensors
+        {
+            for(int i = FIRST_CLIENT; i < (conn_counter+FIRST_CLIENT); i++)
+            {
+                client = table_lookup(poll_fds[i].fd);
+                if(client != NULL && client->throttled_until != 0) continue; // stays off until its throttle ends
+                poll_fds[i].events = paused ? 0 : (POLLIN | POLLHUP);
+                if(!paused && client != NULL) client->last_active = loop_now; // sensors were silent because of us, do not time them out
+            }
         }
     }
-    
-    if(poll_res == -1)
-    {
-        *retval = CONNMGR_SERVER_POLL_ERROR;
-        
-        asprintf(&send_buf, "%ld Connection Manager: error polling sockets", time(NULL));
-        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
-    }
 
-    #if (DEBUG_LVL > 0)
-    printf("Connection Manager: total %d messages processed during session\n", sbuffer_insertions);
-    fflush(stdout);
-    #endif
+    return poll_res;
 }
 
-void connmgr_free()
+// Closes the connection polled at poll_fds[i], the last descriptor is moved into the freed slot as order of poll_fds does not matter
+static void poll_remove(int i, int * conn_counter)
 {
     char * send_buf;
+    client_t * client = table_lookup(poll_fds[i].fd);
 
-    if(server != NULL && tcp_close(&server) != TCP_NO_ERROR) 
-    {
-        *retval = CONNMGR_SERVER_CLOSE_ERROR; // close master socket if any
-        
-        asprintf(&send_buf, "%ld Connection Manager: failed to stop", time(NULL));
-        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
-    } else
+    #if (DEBUG_LVL > 1)
+    printf("Peer closed connection or timed out - %d of %d\n", i, *conn_counter);
+    fflush(stdout);
+    #endif
+
+    if(client != NULL)
     {
-        asprintf(&send_buf, "%ld Connection Manager: stopped successfully", time(NULL));        
+        asprintf(&send_buf, "%ld Connection Manager: connection to %"PRIu16" closed", time(NULL), client->sensor);
         write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+
+        table_remove(client->sd);
+        socket_free(client); // Close and free connection if element exists
     }
-    if(poll_fds != NULL) free(poll_fds); // Clean up allocated socket descriptor array if any
-    if(socket_list != NULL) dpl_free(&socket_list, true); // Clean up allocated tcpsock_dpl_el dplist if any
+    poll_fds[i] = poll_fds[*conn_counter+FIRST_CLIENT-1];
+    if((client = table_lookup(poll_fds[i].fd)) != NULL) client->idx = i;
+    (*conn_counter)--; // Decrement number of sockets
 
-    pthread_rwlock_wrlock(sbuffer_open_rwlock); // lock mutex to sbuffer_open shared data
     #if (DEBUG_LVL > 0)
-    printf("Server is shutting down. Closing shared buffer\n");
-    fflush(stdout);
+    printf("Connection Manager: %d connections open\n", *conn_counter);
     #endif
-    *sbuffer_open = 0; // indicate reader threads the end of buffer
-    pthread_rwlock_unlock(sbuffer_open_rwlock);
 }
+#endif
 
-static void * socket_copy(void * element)
+#if (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+// Event loop on io_uring, connections are accepted and read by multishot requests and all completions of a wakeup are handled in one go
+static int uring_loop(sbuffer_shard_t * buffer, int * sbuffer_insertions)
 {
-    struct tcpsock_dpl_el * dummy = (struct tcpsock_dpl_el *) malloc(sizeof(struct tcpsock_dpl_el));
-    dummy->sock_ptr = ((struct tcpsock_dpl_el *) element)->sock_ptr;
-    dummy->sd = ((struct tcpsock_dpl_el *) element)->sd;
-    dummy->last_active = ((struct tcpsock_dpl_el *) element)->last_active;
-    dummy->sensor = ((struct tcpsock_dpl_el *) element)->sensor;
-    return dummy;
-}
+    struct io_uring_cqe * cqe;
+    client_t * client;
+    int server_sd, wait_res, conn_counter = 0;
+    int paused = 0; // set while the shared buffer is above its high-water mark
+    int accepting = URING_IDLE; // the accept is cancelled while MAX_CONN connections are open
 
-static void socket_free(void ** element)
-{
-    tcp_close(&(((struct tcpsock_dpl_el *) *element)->sock_ptr)); // Close connection to that socket
-    free((struct tcpsock_dpl_el *) *element); // Free allocated space of the dplist element
-    *element = NULL; // Set pointer to a dplist element pointing to NULL
-}
+    tcp_get_sd(server, &server_sd);
+    connmgr_uring_poll(&ring, *ctl_efd, URING_CONTROL);
+    connmgr_uring_poll(&ring, workers[worker].efd, URING_WORKER);
 
-static int socket_compare(void * x, void * y)
-{
-    return ((((struct tcpsock_dpl_el *) x)->sd == ((struct tcpsock_dpl_el *) y)->sd) ? 0 : ((((struct tcpsock_dpl_el *) x)->sd > ((struct tcpsock_dpl_el *) y)->sd) ? -1 : 1));
-}
\ No newline at end of file
+    while(1)
+    {
+        if(accepting == URING_IDLE && conn_counter < MAX_CONN)
+        {
+            connmgr_uring_accept(&ring, server_sd, URING_ACCEPT);
+            accepting = URING_ARMED;
+        } else if(accepting == URING_ARMED && conn_counter >= MAX_CONN)
+        {
+            connmgr_uring_cancel(&ring, URING_ACCEPT, URING_CANCEL);
+            accepting = URING_CANCELLED;
+        }
+
+        int timeout = (paused && conn_counter) ? CONNMGR_BACKPRESSURE_POLL : conn_counter ? connmgr_wheel_timeout(&idle_timers, connmgr_clock_ms()) : idle_timeout(); // wake up when the next idle connection is due
+        wait_res = connmgr_uring_wait(&ring, timeout);
+        if(wait_res < 0 && wait_res != -ETIME && wait_res != -EINTR) return -1;
+        if(wait_res != -EINTR && connmgr_uring_peek(&ring) == NULL && conn_counter == 0 && idle_shutdown()) break; // Repeat until the wait times out after no connections are left on any worker
+        loop_now = connmgr_clock_ms();
+
+        for(unsigned ready = connmgr_uring_ready(&ring); ready > 0 && (cqe = connmgr_uring_peek(&ring)) != NULL; ready--) // only what completed before this wakeup, later completions wait for the next one
+        {
+            uint64_t user_data = cqe->user_data;
+            int res = cqe->res, more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+            int bid = (cqe->flags & IORING_CQE_F_BUFFER) ? connmgr_uring_buffer_id(cqe) : -1;
+            unsigned char * data = (bid != -1) ? connmgr_uring_buffer(&ring, cqe) : NULL;
+            connmgr_uring_seen(&ring); // the buffer stays with us until it is returned
+
+            if(user_data == URING_ACCEPT)
+            {
+                if(!more) accepting = URING_IDLE; // armed again at the top of the loop if there is room
+                if(res >= 0 && conn_counter >= MAX_CONN) close(res); // accepted before the cancellation took effect
+                else if(res >= 0)
+                {
+                    if((client = client_create(NULL, res)) == NULL || table_insert(client) == -1)
+                    {
+                        if(client != NULL) socket_free(client);
+                        else close(res);
+                        continue;
+                    }
+                    conn_counter++;
+                    client->armed = 1;
+                    connmgr_uring_recv(&ring, client->sd, (uint64_t) (uintptr_t) client);
+                } else if(res != -ECANCELED && res != -EINTR && res != -EAGAIN)
+                {
+                    char * send_buf;
+                    *retval = CONNMGR_SERVER_CONNECTION_ERROR;
+
+                    asprintf(&send_buf, "%ld Connection Manager: failed to accept new connection (%d)", time(NULL), res);
+                    write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+                }
+            } else if(user_data == URING_CONTROL || user_data == URING_WORKER)
+            {
+                if(handle_control_event() == CONNMGR_STOP) return 0;
+                if(!more) connmgr_uring_poll(&ring, (user_data == URING_CONTROL) ? *ctl_efd : workers[worker].efd, user_data);
+            } else if(user_data != URING_CANCEL)
+            {
+                client = (client_t *) (uintptr_t) user_data;
+                if(!more) client->armed = 0;
+
+                if(res > 0 && !client->closing && uring_receive(client, data, res, buffer, sbuffer_insertions) == -1) res = -EPROTO;
+                if(bid != -1) connmgr_uring_buffer_return(&ring, (uint16_t) bid);
+
+                if(client->closing)
+                {
+                    if(client->armed) continue;
+                    table_remove(client->sd); // the kernel is done with the connection
+                    socket_free(client);
+                } else if(res == 0 || (res < 0 && res != -ENOBUFS && res != -ECANCELED)) // peer closed the connection or it broke
+                {
+                    char * send_buf;
+                    asprintf(&send_buf, "%ld Connection Manager: lost connection with", time(NULL));
+                    write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+                    uring_close(client, &conn_counter);
+                } else if(!client->armed && !paused && client->throttled_until == 0) // out of buffers or cut short, anything unread is still in the socket
+                {
+                    client->armed = 1;
+                    connmgr_uring_recv(&ring, client->sd, user_data);
+                }
+            }
+        }
+
+        run_commands(&conn_counter);
+
+        while(!paused && (client = expire_idle_client()) != NULL) uring_close(client, &conn_counter); // sensors are not timed out while we do not read them
+
+        *sbuffer_insertions += flush_batch(buffer); // publish everything received during this wakeup
+
+        int was_paused = paused;
+        paused = check_backpressure(buffer, paused);
+        for(int sd = 0; paused != was_paused && sd < conn_table_size; sd++) // unread data stays in the kernel socket buffers, TCP flow control stalls the sensors
+        {
+            if((client = conn_table[sd]) == NULL || client->closing || client->throttled_until != 0) continue; // throttled ones are resumed when their throttle ends
+
+            if(paused && client->armed) connmgr_uring_cancel(&ring, (uint64_t) (uintptr_t) client, URING_CANCEL); // receive ends with -ECANCELED
+            else if(!paused)
+            {
+                client->last_active = loop_now; // sensors were silent because of us, do not time them out
+                if(!client->armed)
+                {
+                    client->armed = 1;
+                    connmgr_uring_recv(&ring, client->sd, (uint64_t) (uintptr_t) client);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+// Decodes the 'len' bytes of a provided buffer, a reading or frame split over buffers is put together in rx_buf
+// Returns -1 if the peer does not speak the protocol
+static int uring_receive(client_t * client, unsigned char * data, int len, sbuffer_shard_t * buffer, int * sbuffer_insertions)
+{
+    int pos = 0, decoded;
+
+    if(client->rx_len > 0) // complete what the previous buffers left first, it starts at a reading or frame
+    {
+        int kept = client->rx_len, copied = CONNMGR_RX_BUFFER - kept;
+        if(copied > len) copied = len;
+        memcpy(&(client->rx_buf[kept]), data, copied);
+
+        if((decoded = decode_readings(client, client->rx_buf, kept + copied, buffer, sbuffer_insertions)) == -1) return -1;
+        if(decoded == 0) // still incomplete, decode_readings refuses frames that do not fit in rx_buf
+        {
+            client->rx_len = kept + copied;
+            return (copied == len) ? 0 : -1;
+        }
+        pos = decoded - kept; // the rest is decoded from the buffer itself
+        client->rx_len = 0;
+    }
+
+    if((decoded = decode_readings(client, &(data[pos]), len - pos, buffer, sbuffer_insertions)) == -1) return -1; // straight from the provided buffer, no copy
+    pos += decoded;
+    client->rx_len = len - pos;
+    memcpy(client->rx_buf, &(data[pos]), client->rx_len);
+
+    return 0;
+}
+
+// Takes the connection out of service, it is freed once its receive completed for the last time
+static void uring_close(client_t * client, int * conn_counter)
+{
+    char * send_buf;
+
+    asprintf(&send_buf, "%ld Connection Manager: connection to %"PRIu16" closed", time(NULL), client->sensor);
+    write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+
+    connmgr_wheel_remove(&idle_timers, &(client->timer));
+    client->closing = 1;
+    (*conn_counter)--;
+
+    #if (DEBUG_LVL > 0)
+    printf("Connection Manager: %d connections open\n", *conn_counter);
+    #endif
+
+    if(client->armed) connmgr_uring_cancel(&ring, (uint64_t) (uintptr_t) client, URING_CANCEL); // the descriptor is closed after the receive ended, the kernel would keep it open until then
+    else
+    {
+        table_remove(client->sd);
+        socket_free(client);
+    }
+}
+#endif
+
+static void socket_free(client_t * client)
+{
+    connmgr_wheel_remove(&idle_timers, &(client->timer));
+    if(client->sensor < sensor_table_size && sensor_table[client->sensor] == client) sensor_table[client->sensor] = NULL; // an older connection of the sensor is not indexed
+    if(client->sock_ptr != NULL) tcp_close(&(client->sock_ptr)); // Close connection to that socket
+    else close(client->sd); // accepted by io_uring, there is no tcpsock_t around it
+    free(client);
+}
+
+// Makes 'client' reachable by its socket descriptor, grows the table to the descriptor if needed
+static int table_insert(client_t * client)
+{
+    if(client->sd >= conn_table_size)
+    {
+        int size = conn_table_size ? conn_table_size : CONNMGR_TABLE_SIZE;
+        while(size <= client->sd) size *= 2;
+        client_t ** table = (client_t **) realloc(conn_table, sizeof(client_t *)*size);
+        if(table == NULL) return -1;
+        memset(&(table[conn_table_size]), 0, sizeof(client_t *)*(size - conn_table_size));
+        conn_table = table;
+        conn_table_size = size;
+    }
+    conn_table[client->sd] = client;
+    atomic_fetch_add_explicit(&open_connections, 1, memory_order_relaxed);
+
+    return 0;
+}
+
+// Makes 'client' the connection commands about its sensor go to, grows the table to the sensor id if needed
+static int sensor_insert(client_t * client)
+{
+    if(client->sensor >= sensor_table_size)
+    {
+        int size = sensor_table_size ? sensor_table_size : CONNMGR_TABLE_SIZE;
+        while(size <= client->sensor) size *= 2;
+        client_t ** table = (client_t **) realloc(sensor_table, sizeof(client_t *)*size);
+        if(table == NULL) return -1;
+        memset(&(table[sensor_table_size]), 0, sizeof(client_t *)*(size - sensor_table_size));
+        sensor_table = table;
+        sensor_table_size = size;
+    }
+    sensor_table[client->sensor] = client;
+
+    return 0;
+}
+
+static client_t * sensor_lookup(int sensor)
+{
+    client_t * client = (sensor > 0 && sensor < sensor_table_size) ? sensor_table[sensor] : NULL;
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+    if(client != NULL && client->closing) return NULL; // out of service already, freed once its receive ended
+    #endif
+
+    return client;
+}
+
+#if (CONNMGR_BACKEND != CONNMGR_BACKEND_EPOLL) // epoll hands the connection back in the event
+static client_t * table_lookup(int sd)
+{
+    return (sd >= 0 && sd < conn_table_size) ? conn_table[sd] : NULL;
+}
+#endif
+
+static void table_remove(int sd)
+{
+    if(sd >= 0 && sd < conn_table_size && conn_table[sd] != NULL)
+    {
+        conn_table[sd] = NULL;
+        atomic_store_explicit(&idle_since, connmgr_clock_ms(), memory_order_relaxed); // before the count drops, a worker that sees 0 sees this close as well
+        atomic_fetch_sub_explicit(&open_connections, 1, memory_order_release);
+    }
+}
+
+// Accepts one pending connection, returns NULL if there is none or it failed
+static client_t * accept_client(void)
+{
+    char * send_buf;
+    int tcp_conn_res;
+
+    #if (DEBUG_LVL > 1)
+    printf("Incoming client connection\n");
+    fflush(stdout);
+    #endif
+
+    tcpsock_t * sock;
+    int sd;
+    client_t * client;
+
+    if((tcp_conn_res = tcp_wait_for_connection(server, &sock)) != TCP_NO_ERROR) // Blocks until a connection is processed, unless the server socket is non-blocking
+    {
+        if(errno == EAGAIN || errno == EWOULDBLOCK) return NULL; // backlog empty
+
+        *retval = CONNMGR_SERVER_CONNECTION_ERROR;
+
+        asprintf(&send_buf, "%ld Connection Manager: failed to accept new connection (%d)", time(NULL), tcp_conn_res);
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+
+        return NULL;
+    }
+
+    tcp_get_sd(sock, &sd);
+    fcntl(sd, F_SETFL, fcntl(sd, F_GETFL) | O_NONBLOCK); // readings are received with as few recv calls as possible, never waiting for the rest
+    if((client = client_create(sock, sd)) == NULL) tcp_close(&sock);
+
+    return client;
+}
+
+// Sets up the connection on 'sd' and starts its idle timer, 'sock' is NULL for descriptors accepted by io_uring
+static client_t * client_create(tcpsock_t * sock, int sd)
+{
+    char * send_buf;
+    client_t * client = (client_t *) malloc(sizeof(client_t));
+    if(client == NULL) return NULL;
+
+    client->sock_ptr = sock;
+    client->sd = sd;
+    client->last_active = loop_now;
+    client->sensor = 0;
+    client->throttled_until = 0;
+    client->proto = 0;
+    client->rx_len = 0;
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+    client->armed = client->closing = 0;
+    #endif
+    client->timer.prev = client->timer.next = NULL;
+    connmgr_wheel_add(&idle_timers, &(client->timer), loop_now + (uint64_t) TIMEOUT*1000);
+
+    asprintf(&send_buf, "%ld Connection Manager: new connection received", time(NULL));
+    write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+
+    return client;
+}
+
+// Receives what the socket of 'client' holds with one recv, decodes every complete reading into the shared buffer and keeps a partial one for the next call
+// Returns the number of bytes received, 0 if the peer closed the connection and -1 with errno set if nothing was available or an error occured
+static ssize_t receive_readings(client_t * client, sbuffer_shard_t * buffer, int * sbuffer_insertions)
+{
+    ssize_t received = recv(client->sd, &(client->rx_buf[client->rx_len]), CONNMGR_RX_BUFFER - client->rx_len, 0);
+    if(received <= 0) return received;
+
+    int len = client->rx_len + (int) received;
+    int pos = decode_readings(client, client->rx_buf, len, buffer, sbuffer_insertions);
+    if(pos == -1)
+    {
+        errno = EPROTO;
+        return -1;
+    }
+    client->rx_len = len - pos;
+    if(client->rx_len > 0 && pos > 0) memmove(client->rx_buf, &(client->rx_buf[pos]), client->rx_len);
+
+    return received;
+}
+
+// Decodes every complete reading or frame of the 'len' bytes at 'data' into the shared buffer, the protocol is told by the first bytes of the connection
+// Returns the number of bytes decoded or -1 if the peer does not speak the protocol
+static int decode_readings(client_t * client, unsigned char * data, int len, sbuffer_shard_t * buffer, int * sbuffer_insertions)
+{
+    int pos = 0, decoded;
+
+    if(client->proto == 0)
+    {
+        uint16_t magic;
+        if(len < (int) sizeof(magic)) return 0;
+        memcpy(&magic, data, sizeof(magic));
+        if(magic != PROTO_MAGIC) client->proto = PROTO_V1; // legacy node, the bytes are its first reading
+        else if(len < (int) PROTO_HELLO_SIZE) return 0;
+        else
+        {
+            if(answer_hello(client, data[sizeof(magic)]) == -1) return -1;
+            pos = PROTO_HELLO_SIZE;
+        }
+    }
+
+    if(client->proto == PROTO_V1) decoded = decode_v1(client, &(data[pos]), len - pos, buffer, sbuffer_insertions);
+    else decoded = decode_frames(client, &(data[pos]), len - pos, buffer, sbuffer_insertions);
+
+    if(decoded == CONNMGR_REFUSED) return -1; // logged by accept_sensor
+    if(decoded == -1)
+    {
+        char * send_buf;
+        asprintf(&send_buf, "%ld Connection Manager: invalid frame from sensor %"PRIu16, time(NULL), client->sensor);
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+
+        return -1;
+    }
+    if(decoded > 0) client->last_active = loop_now; // Make sure to update last_active only when a complete reading was received
+
+    #if (CONNMGR_WORKERS > 1)
+    for(int shard = 0; shard < SBUFFER_SHARDS; shard++) // another worker waits for a shard this one holds, it does not wait until the end of the wakeup
+    {
+        if(reservations[shard].reserved > 0 && sbuffer_shard_contended(buffer, shard)) *sbuffer_insertions += commit_reservation(buffer, shard);
+    }
+    #endif
+
+    return pos + decoded;
+}
+
+// Decodes readings sent one by one as <sensor_id><temperature><timestamp> without padding
+static int decode_v1(client_t * client, unsigned char * data, int len, sbuffer_shard_t * buffer, int * sbuffer_insertions)
+{
+    int pos = 0;
+    for(; len - pos >= (int) PROTO_V1_READING_SIZE; pos += PROTO_V1_READING_SIZE)
+    {
+        sensor_id_t id;
+        memcpy(&id, &(data[pos]), sizeof(id));
+        if((client->sensor == 0 || id != client->sensor) && accept_sensor(client, id) == -1) return CONNMGR_REFUSED;
+        reservation_t * batch = reserve_slot(buffer, sbuffer_shard_of(buffer, id), sbuffer_insertions);
+        if(batch == NULL)
+        {
+            workers[worker].dropped++;
+            continue;
+        }
+        sensor_data_t * reading = &(batch->slots[batch->used]); // straight into the shared buffer
+        reading->id = id;
+        memcpy(&(reading->value), &(data[pos + sizeof(reading->id)]), sizeof(reading->value));
+        memcpy(&(reading->ts), &(data[pos + sizeof(reading->id) + sizeof(reading->value)]), sizeof(reading->ts));
+        push_reading(batch);
+    }
+
+    return pos;
+}
+
+// Decodes frames <length><encoding><sensor_id><count><base_ts> followed by 'count' readings, returns -1 on a malformed frame
+static int decode_frames(client_t * client, unsigned char * data, int len, sbuffer_shard_t * buffer, int * sbuffer_insertions)
+{
+    int pos = 0;
+    uint16_t length, count;
+    uint8_t encoding;
+    sensor_id_t id;
+    sensor_ts_t base_ts;
+    proto_codec_t codec;
+
+    while(len - pos >= (int) sizeof(length))
+    {
+        memcpy(&length, &(data[pos]), sizeof(length));
+        if(length < PROTO_HEADER_SIZE - sizeof(length) || length > PROTO_FRAME_SIZE - sizeof(length)) return -1; // would never be received whole
+        if(len - pos < (int) sizeof(length) + length) break; // rest of the frame is still on its way
+
+        unsigned char * field = &(data[pos + sizeof(length)]);
+        memcpy(&encoding, field, sizeof(encoding));
+        field += sizeof(encoding);
+        memcpy(&id, field, sizeof(id));
+        field += sizeof(id);
+        memcpy(&count, field, sizeof(count));
+        field += sizeof(count);
+        memcpy(&base_ts, field, sizeof(base_ts));
+        field += sizeof(base_ts);
+        int left = length - (int) (PROTO_HEADER_SIZE - sizeof(length)); // bytes of the readings
+        if(count > PROTO_FRAME_MAX || (encoding != PROTO_ENC_RAW && client->proto < PROTO_V3) || proto_codec_init(&codec, encoding, base_ts) == PROTO_FAILURE) return -1;
+        if(frame_valid(codec, field, left, count) == -1) return -1; // readings are committed as they are decoded, a bad one halfway could not be taken back
+        if((client->sensor == 0 || id != client->sensor) && accept_sensor(client, id) == -1) return CONNMGR_REFUSED;
+
+        int shard = sbuffer_shard_of(buffer, id); // all readings of a frame go to the same shard
+        for(int i = 0, used; i < count; i++, field += used, left -= used)
+        {
+            sensor_data_t dropped;
+            reservation_t * batch = reserve_slot(buffer, shard, sbuffer_insertions);
+            sensor_data_t * reading = (batch != NULL) ? &(batch->slots[batch->used]) : &dropped; // decoded regardless, the next reading is relative to it
+            used = proto_decode(&codec, field, left, &(reading->value), &(reading->ts)); // cannot fail, see frame_valid
+            reading->id = id;
+            if(batch != NULL) push_reading(batch);
+            else workers[worker].dropped++;
+        }
+        pos += sizeof(length) + length;
+    }
+
+    return pos;
+}
+
+// Decodes the 'count' readings in the 'left' bytes at 'field' with a copy of 'codec' and throws them away
+// Returns -1 if a reading is malformed or the readings do not fill the frame exactly, 0 otherwise
+static int frame_valid(proto_codec_t codec, const unsigned char * field, int left, int count)
+{
+    sensor_value_t value;
+    sensor_ts_t ts;
+
+    if(codec.encoding == PROTO_ENC_RAW) return (left == count*(int) PROTO_RAW_READING_SIZE) ? 0 : -1; // fixed size, nothing to decode
+    for(int i = 0, used; i < count; i++, field += used, left -= used)
+    {
+        if((used = proto_decode(&codec, field, left, &value, &ts)) == PROTO_FAILURE) return -1;
+    }
+
+    return (left == 0) ? 0 : -1; // length does not match the readings
+}
+
+// Agrees on the highest version both sides speak and tells the node, returns -1 if there is none or the answer could not be sent
+static int answer_hello(client_t * client, uint8_t version)
+{
+    unsigned char hello[PROTO_HELLO_SIZE];
+    uint16_t magic = PROTO_MAGIC;
+
+    if(version < PROTO_V1) return -1;
+    if(version > PROTO_VERSION) version = PROTO_VERSION;
+    memcpy(hello, &magic, sizeof(magic));
+    hello[sizeof(magic)] = version;
+    if(send(client->sd, hello, sizeof(hello), MSG_NOSIGNAL | MSG_DONTWAIT) != (ssize_t) sizeof(hello)) return -1; // the send buffer of a new connection is empty, this never waits
+    client->proto = version;
+
+    return 0;
+}
+
+// Checks a sensor id the connection did not send before against the sensor map, the first one names the connection
+// Returns -1 if the sensor is not registered, the connection is closed then and none of its readings are decoded
+static int accept_sensor(client_t * client, sensor_id_t id)
+{
+    if(sensor_map != NULL && !SENSOR_MAP_HAS(sensor_map, id))
+    {
+        char * send_buf;
+        asprintf(&send_buf, "%ld Connection Manager: sensor %"PRIu16" is not registered, connection refused", time(NULL), id);
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+
+        return -1;
+    }
+    if(client->sensor == 0)
+    {
+        client->sensor = id;
+        sensor_insert(client); // not found by commands if this fails, the connection works regardless
+    }
+
+    return 0;
+}
+
+// Counts the reading decoded into the next slot of 'batch', the reservation is committed once it is used up or at the end of the wakeup
+static void push_reading(reservation_t * batch)
+{
+    #if (DEBUG_LVL > 1)
+    sensor_data_t * reading = &(batch->slots[batch->used]);
+    printf("Received for shared buffer: %" PRIu16 " %g %ld\n", reading->id, reading->value, reading->ts);
+    fflush(stdout);
+    #endif
+
+    batch->used++;
+}
+
+// Returns the reservation in shard 'shard' with the next free slot, a used up reservation is committed and a new one made
+// Returns NULL if the shared buffer refused to reserve, the reading is dropped then
+static reservation_t * reserve_slot(sbuffer_shard_t * buffer, int shard, int * sbuffer_insertions)
+{
+    reservation_t * batch = &(reservations[shard]);
+    if(batch->reserved > 0 && batch->used == batch->reserved) *sbuffer_insertions += commit_reservation(buffer, shard);
+    if(batch->reserved > 0) return batch;
+
+    int res = sbuffer_shard_reserve(buffer, shard, &(batch->slots), SBUFFER_BATCH_SIZE, 0);
+    if(res == SBUFFER_PENDING) // another worker holds the shard, ours are committed before waiting so that no two workers wait for each other
+    {
+        *sbuffer_insertions += flush_batch(buffer);
+        res = sbuffer_shard_reserve(buffer, shard, &(batch->slots), SBUFFER_BATCH_SIZE, 1);
+    }
+    if(res <= 0) return NULL;
+    batch->reserved = res;
+    batch->used = 0;
+
+    return batch;
+}
+
+// Publishes the readings decoded into the reservation of shard 'shard' and lets go of the shard, returns the number of readings inserted
+static int commit_reservation(sbuffer_shard_t * buffer, int shard)
+{
+    reservation_t * batch = &(reservations[shard]);
+    int inserted = (sbuffer_shard_commit(buffer, shard, batch->used) == SBUFFER_SUCCESS) ? batch->used : 0; // sbuffer implementation takes care of thread safety
+
+    #if (DEBUG_LVL > 1)
+    printf("%s batch of %d readings in shared buffer\n", inserted ? "Inserted" : "Failed to insert", batch->used);
+    fflush(stdout);
+    #endif
+
+    batch->reserved = batch->used = 0;
+    return inserted;
+}
+
+// Consumes the control eventfds, returns CONNMGR_STOP if storagemgr failed or connmgr went idle and 0 otherwise, commands are run later in the wakeup
+// The worker that takes an event from the shared control eventfd passes it on to the others, the commands may be in their queues
+static int handle_control_event(void)
+{
+    char * send_buf;
+    uint64_t events;
+
+    if(read(*ctl_efd, &events, sizeof(events)) > 0) // resets the eventfd counter, only one worker gets it, flags and queues are looked at after so no change is missed
+    {
+        for(int w = 0; w < CONNMGR_WORKERS; w++)
+        {
+            if(w != worker) write_to_event(&(workers[w].efd));
+        }
+    }
+    read(workers[worker].efd, &events, sizeof(events));
+
+    if(atomic_load(storagemgr_fail_flag))
+    {
+        *retval = CONNMGR_INTERRUPTED_BY_STORAGEMGR;
+
+        asprintf(&send_buf, "%ld Connection Manager: signalled to terminate by Storage Manager", time(NULL));
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+
+        return CONNMGR_STOP; // connections are closed when the worker is freed
+    }
+    if(atomic_load(&idle_stop)) return CONNMGR_STOP; // another worker decided connmgr has been idle for TIMEOUT
+
+    return 0;
+}
+
+// Wait of a worker without connections, until connmgr as a whole would be idle for TIMEOUT, or TIMEOUT while other workers have connections
+static int idle_timeout(void)
+{
+    if(atomic_load_explicit(&open_connections, memory_order_acquire) != 0) return TIMEOUT*1000;
+
+    uint64_t idle = connmgr_clock_ms() - atomic_load_explicit(&idle_since, memory_order_relaxed);
+    return (idle >= (uint64_t) TIMEOUT*1000) ? 0 : (int) ((uint64_t) TIMEOUT*1000 - idle);
+}
+
+// Called by a worker whose wait timed out without connections, returns 1 once no worker had a connection for TIMEOUT
+// The first worker to see it sets idle_stop and wakes the others, so every listening socket is closed together
+static int idle_shutdown(void)
+{
+    if(atomic_load(&idle_stop)) return 1;
+    if(idle_timeout() != 0) return 0; // connections left on other workers or one closed less than TIMEOUT ago
+
+    if(atomic_exchange(&idle_stop, 1) == 0)
+    {
+        for(int w = 0; w < CONNMGR_WORKERS; w++)
+        {
+            if(w != worker) write_to_event(&(workers[w].efd));
+        }
+    }
+
+    return 1;
+}
+
+// Runs the commands waiting in the queue of the calling worker, the connection of a sensor is found through the sensor index
+static void run_commands(int * conn_counter)
+{
+    char * send_buf;
+    connmgr_cmd_t cmd;
+    client_t * client;
+
+    while(connmgr_queue_pop(&(workers[worker].commands), &cmd) == CONNMGR_QUEUE_SUCCESS)
+    {
+        switch(cmd.type)
+        {
+            case CONNMGR_CMD_DROP:
+                if((client = sensor_lookup(cmd.sensor)) == NULL) break; // held by another worker or gone already
+
+                asprintf(&send_buf, "%ld Connection Manager: signalled to drop connection to %"PRIu16, time(NULL), client->sensor);
+                write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+                drop_client(client, conn_counter);
+                break;
+            case CONNMGR_CMD_THROTTLE:
+                if((client = sensor_lookup(cmd.sensor)) == NULL || cmd.arg <= 0) break;
+
+                asprintf(&send_buf, "%ld Connection Manager: sensor %"PRIu16" throttled for %d ms", time(NULL), client->sensor, cmd.arg);
+                write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+                throttle_client(client, cmd.arg);
+                break;
+            case CONNMGR_CMD_RELOAD: // only sent to worker 0
+                if(connmgr_load_sensor_map(sensor_map) == -1)
+                {
+                    asprintf(&send_buf, "%ld Connection Manager: failed to re-read room_sensor.map", time(NULL));
+                    write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+                    break;
+                }
+                asprintf(&send_buf, "%ld Connection Manager: re-read room_sensor.map", time(NULL));
+                write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+
+                cmd.type = CONNMGR_CMD_SWEEP;
+                for(int w = 1; w < CONNMGR_WORKERS; w++)
+                {
+                    if(connmgr_queue_push(&(workers[w].commands), &cmd) == CONNMGR_QUEUE_SUCCESS) write_to_event(&(workers[w].efd));
+                }
+                sweep_clients(conn_counter);
+                break;
+            case CONNMGR_CMD_SWEEP:
+                sweep_clients(conn_counter);
+                break;
+        }
+    }
+}
+
+// Drops the connections of sensors that are no longer in the sensor map
+static void sweep_clients(int * conn_counter)
+{
+    char * send_buf;
+    client_t * client;
+
+    for(int sd = 0; sd < conn_table_size; sd++)
+    {
+        if((client = conn_table[sd]) == NULL || client->sensor == 0 || SENSOR_MAP_HAS(sensor_map, client->sensor)) continue;
+        #if (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+        if(client->closing) continue;
+        #endif
+
+        asprintf(&send_buf, "%ld Connection Manager: sensor %"PRIu16" no longer registered", time(NULL), client->sensor);
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+        drop_client(client, conn_counter);
+    }
+}
+
+// Closes 'client' the way the running event loop does
+static void drop_client(client_t * client, int * conn_counter)
+{
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_EPOLL)
+    (void) conn_counter; // kept by the loop itself
+    close_client(client);
+    #else
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+    if(ring.fd != -1)
+    {
+        uring_close(client, conn_counter);
+        return;
+    }
+    #endif
+    poll_remove(client->idx, conn_counter);
+    #endif
+}
+
+// Stops reading from 'client' for 'ms', TCP flow control stalls the sensor meanwhile. Its timer is moved to the end of the throttle
+static void throttle_client(client_t * client, int ms)
+{
+    client->throttled_until = loop_now + (uint64_t) ms;
+    connmgr_wheel_remove(&idle_timers, &(client->timer));
+    connmgr_wheel_add(&idle_timers, &(client->timer), client->throttled_until);
+
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_EPOLL)
+    unmark_ready(client);
+    #else
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+    if(ring.fd != -1)
+    {
+        if(client->armed) connmgr_uring_cancel(&ring, (uint64_t) (uintptr_t) client, URING_CANCEL); // receive ends with -ECANCELED and is not armed again
+        return;
+    }
+    #endif
+    poll_fds[client->idx].events = 0; // hang-ups are still reported
+    #endif
+}
+
+// Reads from 'client' again once its throttle ended, whatever the sensor sent meanwhile is still in the socket
+static void resume_client(client_t * client)
+{
+    client->throttled_until = 0;
+    client->last_active = loop_now; // silent because of us, do not time it out
+
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_EPOLL)
+    mark_ready(client); // no new edge is raised for data that arrived meanwhile
+    #else
+    #if (CONNMGR_BACKEND == CONNMGR_BACKEND_URING)
+    if(ring.fd != -1)
+    {
+        if(!client->armed && !client->closing)
+        {
+            client->armed = 1;
+            connmgr_uring_recv(&ring, client->sd, (uint64_t) (uintptr_t) client);
+        }
+        return;
+    }
+    #endif
+    poll_fds[client->idx].events = POLLIN | POLLHUP;
+    #endif
+}
+
+// Returns a connection that did not send a reading for TIMEOUT, connections that did since their timer was set get it moved instead
+static client_t * expire_idle_client(void)
+{
+    connmgr_timer_t * timer;
+
+    while((timer = connmgr_wheel_expire(&idle_timers, loop_now)) != NULL)
+    {
+        client_t * client = (client_t *) ((char *) timer - offsetof(client_t, timer));
+        if(client->throttled_until != 0) // the timer marked the end of the throttle, not an idle deadline
+        {
+            resume_client(client);
+            connmgr_wheel_add(&idle_timers, timer, loop_now + (uint64_t) TIMEOUT*1000);
+            continue;
+        }
+        uint64_t deadline = client->last_active + (uint64_t) TIMEOUT*1000;
+
+        if(deadline <= loop_now) return client;
+        connmgr_wheel_add(&idle_timers, timer, deadline);
+    }
+
+    return NULL;
+}
+
+// Commits the reservations of every shard, returns the number of readings inserted
+static int flush_batch(sbuffer_shard_t * buffer)
+{
+    int inserted = 0;
+    for(int shard = 0; shard < SBUFFER_SHARDS; shard++)
+    {
+        if(reservations[shard].reserved > 0) inserted += commit_reservation(buffer, shard);
+    }
+
+    return inserted;
+}
+
+// Returns whether sensors should be paused, with hysteresis between the low and high-water marks of the shared buffer
+static int check_backpressure(sbuffer_shard_t * buffer, int paused)
+{
+    char * send_buf;
+
+    if(SBUFFER_POLICY == SBUFFER_POLICY_SPILL) return 0; // overflow goes to disk, sensors are never stalled
+
+    size_t depth = sbuffer_shard_depth(buffer); // fullest shard, called on every wakeup hence no full stats snapshot
+
+    if(!paused && depth >= high_water)
+    {
+        asprintf(&send_buf, "%ld Connection Manager: buffer at %zu readings, pausing", time(NULL), depth);
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+
+        return 1;
+    } else if(paused && depth <= low_water)
+    {
+        asprintf(&send_buf, "%ld Connection Manager: buffer at %zu readings, resuming", time(NULL), depth);
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+
+        return 0;
+    }
+
+    return paused;
+}
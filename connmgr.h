@@ -1,13 +1,20 @@
 #ifndef _CONNMGR_H_
 #define _CONNMGR_H_
 
-#include "sbuffer.h"
+#include "sbuffer_shard.h"
+
+#define CONNMGR_CMD_DROP 1      // close the connection of 'sensor'
+#define CONNMGR_CMD_THROTTLE 2  // stop reading from the connection of 'sensor' for 'arg' ms
+#define CONNMGR_CMD_RELOAD 3    // re-read room_sensor.map and drop connections of sensors no longer in it
+#define CONNMGR_CMD_SWEEP 4     // internal, drop connections of sensors no longer in the map
 
 /**
  * This method starts listening on the given port and when when a sensor node connects it 
- * stores the sensor data in the shared buffer.
+ * stores the sensor data in the shard of the shared buffer its sensor id maps to.
+ * CONNMGR_WORKERS - 1 additional threads each listen on the same port and serve the connections
+ * they accept, the call returns once all of them timed out without connections
  **/
-void connmgr_listen(int port_number, sbuffer_t ** buffer);
+void connmgr_listen(int port_number, sbuffer_shard_t * buffer);
 
 /**
  * This method should be called to clean up the connmgr, and to free all used memory. 
@@ -17,8 +24,24 @@ void connmgr_free();
 
 /**
  * This method shares variables from threads space to carry out more functionality,
- * like having access to IPC mutex/rwlock and updating the return value of the thread
+ * like having access to IPC mutex and the atomic flags shared between threads and updating
+ * the return value of the thread
  **/
 void connmgr_init(connmgr_init_arg_t * arg);
 
+/**
+ * Queues the command 'type' (CONNMGR_CMD_*) about 'sensor' for the event loops of connmgr and wakes
+ * them up, callable from any thread without locking. A command about a sensor goes to every worker,
+ * the one holding the sensor finds its connection by sensor id, the others ignore it
+ * Returns 0 on success and -1 if a queue was full, the command is lost for that worker then
+ **/
+int connmgr_command(int type, int sensor, int arg);
+
+/**
+ * Reads the sensor ids of room_sensor.map into the SENSOR_MAP_WORDS words of 'map', ids that are
+ * no longer in the file are cleared. Threads reading the map meanwhile see every word old or new
+ * Returns 0 on success and -1 if the file could not be read, 'map' is left as it was then
+ **/
+int connmgr_load_sensor_map(_Atomic uint64_t * map);
+
 #endif /* _CONNMGR_H_ */
\ No newline at end of file
@@ -0,0 +1,75 @@
+/***************************************************************************************************
+ *
+ * FileName:        connmgr_queue.c
+ * Comment:         Lock-free multi-producer/single-consumer command queue into the event loop of a
+ *                  connmgr worker
+ * Dependencies:    Header (.h) files connmgr_queue.h
+ *
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Author                       Date            Version       Comment
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Maxim Yudayev                16/10/2026      1.0           Bounded ring of cells with a lap counter
+ *                                                            each, one CAS per push and none per pop
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * Position 'pos' lives in cell pos % CONNMGR_QUEUE_SIZE, 'lap' is pos rounded down to a multiple of
+ * CONNMGR_QUEUE_SIZE. The seq of a cell is 'lap' while it is free for position 'pos', 'lap' + 1 once
+ * the command at 'pos' is published and 'lap' + CONNMGR_QUEUE_SIZE after it was popped, which frees
+ * the cell for the next lap. All seqs start at 0, the free state of the first lap.
+ *
+ ***************************************************************************************************/
+
+/**
+ * Includes
+ **/
+#define _GNU_SOURCE
+#define BUILDING_GATEWAY
+#include <stdlib.h>
+#include "config.h"
+#include "connmgr_queue.h"
+
+#define QUEUE_MASK (CONNMGR_QUEUE_SIZE - 1)
+
+#if (CONNMGR_QUEUE_SIZE & QUEUE_MASK)
+    #error CONNMGR_QUEUE_SIZE must be a power of 2
+#endif
+
+/**
+ * Functions
+ **/
+//
+int connmgr_queue_push(connmgr_queue_t * queue, const connmgr_cmd_t * cmd)
+{
+    size_t pos = atomic_load_explicit(&(queue->tail), memory_order_relaxed);
+
+    while(1)
+    {
+        connmgr_cell_t * cell = &(queue->cells[pos & QUEUE_MASK]);
+        size_t seq = atomic_load_explicit(&(cell->seq), memory_order_acquire);
+        size_t lap = pos & ~(size_t) QUEUE_MASK;
+
+        if(seq == lap) // free for this position, claim it
+        {
+            if(atomic_compare_exchange_weak_explicit(&(queue->tail), &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+            {
+                cell->cmd = *cmd;
+                atomic_store_explicit(&(cell->seq), lap + 1, memory_order_release); // publish
+                return CONNMGR_QUEUE_SUCCESS;
+            }
+        } else if(seq < lap) return CONNMGR_QUEUE_FULL; // still holds the command of the previous lap
+        else pos = atomic_load_explicit(&(queue->tail), memory_order_relaxed); // another producer took it first
+    }
+}
+
+int connmgr_queue_pop(connmgr_queue_t * queue, connmgr_cmd_t * cmd)
+{
+    connmgr_cell_t * cell = &(queue->cells[queue->head & QUEUE_MASK]);
+    size_t lap = queue->head & ~(size_t) QUEUE_MASK;
+
+    if(atomic_load_explicit(&(cell->seq), memory_order_acquire) != lap + 1) return CONNMGR_QUEUE_EMPTY; // nothing claimed or claimed but not published yet
+    *cmd = cell->cmd;
+    atomic_store_explicit(&(cell->seq), lap + CONNMGR_QUEUE_SIZE, memory_order_release); // free for the next lap
+    queue->head++;
+
+    return CONNMGR_QUEUE_SUCCESS;
+}
@@ -0,0 +1,52 @@
+#ifndef _CONNMGR_QUEUE_H_
+#define _CONNMGR_QUEUE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include "config.h"
+#include "sbuffer_common.h"
+
+#define CONNMGR_QUEUE_SUCCESS 0
+#define CONNMGR_QUEUE_EMPTY 1
+#define CONNMGR_QUEUE_FULL -1
+
+/**
+ * One command for the event loop of a connmgr worker, see connmgr_command
+ **/
+typedef struct {
+    int type;       // CONNMGR_CMD_*
+    int sensor;     // sensor the command is about, CONNMGR_NO_SENSOR if it is not about one
+    int arg;        // ms to stop reading for CONNMGR_CMD_THROTTLE
+} connmgr_cmd_t;
+
+typedef struct {
+    atomic_size_t seq;  // lap of the cell, tells producers and the consumer whose turn it is
+    connmgr_cmd_t cmd;
+} connmgr_cell_t;
+
+/**
+ * Bounded lock-free queue of CONNMGR_QUEUE_SIZE commands, any thread may push, only the worker owning
+ * the queue pops. A producer claims a cell with one CAS on 'tail' and publishes it through the lap of
+ * the cell, producers never wait for each other and the consumer takes no lock
+ * A zero-filled queue is an empty one, a static queue needs no initialisation
+ **/
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_size_t tail;   // next cell to be claimed by a producer
+    _Alignas(CACHE_LINE) size_t head;          // next cell to be popped, consumer only
+    connmgr_cell_t cells[CONNMGR_QUEUE_SIZE];
+} connmgr_queue_t;
+
+/**
+ * Appends a copy of '*cmd' to 'queue', safe to call from any thread at the same time
+ * Returns CONNMGR_QUEUE_SUCCESS or CONNMGR_QUEUE_FULL if all cells hold commands not popped yet
+ **/
+int connmgr_queue_push(connmgr_queue_t * queue, const connmgr_cmd_t * cmd);
+
+/**
+ * Takes the oldest command off 'queue' into '*cmd', only to be called by the thread owning the queue
+ * Returns CONNMGR_QUEUE_SUCCESS or CONNMGR_QUEUE_EMPTY if no published command is waiting
+ **/
+int connmgr_queue_pop(connmgr_queue_t * queue, connmgr_cmd_t * cmd);
+
+#endif /* _CONNMGR_QUEUE_H_ */
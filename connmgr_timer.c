@@ -0,0 +1,115 @@
+/***************************************************************************************************
+ *
+ * FileName:        connmgr_timer.c
+ * Comment:         Hashed timer wheel for the idle deadlines of connmgr's connections, drives the
+ *                  timeout of its event loop
+ * Dependencies:    Header (.h) files connmgr_timer.h
+ *
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Author                       Date            Version       Comment
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Maxim Yudayev                16/10/2026      1.0           Deadlines are kept in ticks, connections
+ *                                                            only re-arm their timer once it fires, so
+ *                                                            receiving a reading touches no list
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * The wheel is only used by the connmgr thread and is not thread safe.
+ *
+ ***************************************************************************************************/
+
+/**
+ * Includes
+ **/
+#define _GNU_SOURCE
+#define BUILDING_GATEWAY
+#include <stdlib.h>
+#include <time.h>
+#include "config.h"
+#include "connmgr_timer.h"
+
+#define WHEEL_MASK (CONNMGR_WHEEL_SLOTS - 1)
+
+#if (CONNMGR_WHEEL_SLOTS & WHEEL_MASK)
+    #error CONNMGR_WHEEL_SLOTS must be a power of 2
+#endif
+
+/**
+ * Functions
+ **/
+//
+uint64_t connmgr_clock_ms(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t) now.tv_sec*1000 + (uint64_t) now.tv_nsec/1000000;
+}
+
+void connmgr_wheel_init(connmgr_wheel_t * wheel, uint64_t now)
+{
+    for(int i = 0; i < CONNMGR_WHEEL_SLOTS; i++) wheel->slots[i].prev = wheel->slots[i].next = &(wheel->slots[i]);
+    wheel->tick = now/CONNMGR_WHEEL_TICK;
+    wheel->count = 0;
+}
+
+void connmgr_wheel_add(connmgr_wheel_t * wheel, connmgr_timer_t * timer, uint64_t deadline)
+{
+    uint64_t tick = (deadline + CONNMGR_WHEEL_TICK - 1)/CONNMGR_WHEEL_TICK; // never fire before the deadline
+    if(tick < wheel->tick) tick = wheel->tick; // the slot of a past tick is not looked at again until the next rotation
+
+    connmgr_timer_t * head = &(wheel->slots[tick & WHEEL_MASK]);
+    timer->expires = tick;
+    timer->prev = head->prev;
+    timer->next = head;
+    head->prev->next = timer;
+    head->prev = timer;
+    wheel->count++;
+}
+
+void connmgr_wheel_remove(connmgr_wheel_t * wheel, connmgr_timer_t * timer)
+{
+    if(timer->next == NULL) return;
+
+    timer->prev->next = timer->next;
+    timer->next->prev = timer->prev;
+    timer->prev = timer->next = NULL;
+    wheel->count--;
+}
+
+connmgr_timer_t * connmgr_wheel_expire(connmgr_wheel_t * wheel, uint64_t now)
+{
+    uint64_t now_tick = now/CONNMGR_WHEEL_TICK;
+
+    if(now_tick >= wheel->tick + CONNMGR_WHEEL_SLOTS) wheel->tick = now_tick - CONNMGR_WHEEL_SLOTS + 1; // one rotation visits every slot, what is due is found regardless of the tick it hashed to
+
+    for(; wheel->count > 0 && wheel->tick <= now_tick; wheel->tick++)
+    {
+        connmgr_timer_t * head = &(wheel->slots[wheel->tick & WHEEL_MASK]);
+        for(connmgr_timer_t * timer = head->next; timer != head; timer = timer->next)
+        {
+            if(timer->expires > now_tick) continue; // a later rotation
+
+            connmgr_wheel_remove(wheel, timer);
+            return timer; // the slot is looked at again on the next call, it may hold more
+        }
+    }
+    if(wheel->count == 0 && wheel->tick <= now_tick) wheel->tick = now_tick + 1;
+
+    return NULL;
+}
+
+int connmgr_wheel_timeout(connmgr_wheel_t * wheel, uint64_t now)
+{
+    if(wheel->count == 0) return -1;
+
+    for(uint64_t tick = wheel->tick; tick < wheel->tick + CONNMGR_WHEEL_SLOTS; tick++) // the first occupied slot may only hold timers of a later rotation, waking up early is harmless
+    {
+        connmgr_timer_t * head = &(wheel->slots[tick & WHEEL_MASK]);
+        if(head->next == head) continue;
+
+        uint64_t due = tick*CONNMGR_WHEEL_TICK;
+        return (due > now) ? (int) (due - now) : 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+#ifndef _CONNMGR_TIMER_H_
+#define _CONNMGR_TIMER_H_
+
+#include <stdint.h>
+#include "config.h"
+
+/**
+ * Hashed timer wheel holding the idle deadlines of the connections of connmgr
+ * The wheel has CONNMGR_WHEEL_SLOTS slots of CONNMGR_WHEEL_TICK ms each, a timer lives in the slot
+ * its deadline hashes to. Deadlines more than one rotation away share a slot with nearer ones and
+ * are skipped until their turn, so expiring costs O(expired) as long as the wheel spans TIMEOUT
+ * Timers are embedded in the object they time out, the wheel allocates nothing
+ **/
+typedef struct connmgr_timer connmgr_timer_t;
+
+struct connmgr_timer {
+    connmgr_timer_t * prev, * next; // NULL while the timer is not on the wheel
+    uint64_t expires;               // tick the timer fires at
+};
+
+typedef struct {
+    connmgr_timer_t slots[CONNMGR_WHEEL_SLOTS]; // list heads, circular so a timer unlinks without knowing its slot
+    uint64_t tick;                              // next tick to be expired
+    int count;                                  // timers on the wheel
+} connmgr_wheel_t;
+
+/**
+ * Returns the monotonic time in ms all deadlines are expressed in
+ **/
+uint64_t connmgr_clock_ms(void);
+
+/**
+ * Empties 'wheel', ticks before 'now' (ms) are considered expired already
+ **/
+void connmgr_wheel_init(connmgr_wheel_t * wheel, uint64_t now);
+
+/**
+ * Puts 'timer' on the wheel to fire at 'deadline' (ms), rounded up to the next tick
+ * A deadline in the past fires on the next call to connmgr_wheel_expire
+ **/
+void connmgr_wheel_add(connmgr_wheel_t * wheel, connmgr_timer_t * timer, uint64_t deadline);
+
+/**
+ * Takes 'timer' off the wheel, does nothing if it is not on it
+ **/
+void connmgr_wheel_remove(connmgr_wheel_t * wheel, connmgr_timer_t * timer);
+
+/**
+ * Takes one timer whose deadline is at or before 'now' (ms) off the wheel and returns it,
+ * returns NULL once none is left. Call until NULL to expire everything due
+ **/
+connmgr_timer_t * connmgr_wheel_expire(connmgr_wheel_t * wheel, uint64_t now);
+
+/**
+ * Returns the time in ms from 'now' until the next occupied slot is due, usable as poll timeout
+ * Returns -1 if the wheel is empty
+ **/
+int connmgr_wheel_timeout(connmgr_wheel_t * wheel, uint64_t now);
+
+#endif /* _CONNMGR_TIMER_H_ */
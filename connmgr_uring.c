@@ -0,0 +1,270 @@
+/***************************************************************************************************
+ *
+ * FileName:        connmgr_uring.c
+ * Comment:         io_uring set up with the raw system calls for the io_uring backend of connmgr,
+ *                  multishot accept, receive into provided buffers and batched completions
+ * Dependencies:    Header (.h) files connmgr_uring.h
+ *
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Author                       Date            Version       Comment
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Maxim Yudayev                16/10/2026      1.0           No liburing, the rings are mapped and
+ *                                                            driven directly, only what connmgr
+ *                                                            needs is implemented
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * The kernel moves the submission head and the completion tail, this thread the submission tail and
+ * the completion head. Acquire loads and release stores on them order the entries in between.
+ * Multishot receive needs Linux 6.0, older kernels are refused in connmgr_uring_init even though the
+ * ring itself could be set up.
+ *
+ ***************************************************************************************************/
+
+/**
+ * Includes
+ **/
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/socket.h>
+#include <sys/utsname.h>
+#include "connmgr_uring.h"
+
+#define URING_BUF_GROUP 0
+
+/**
+ * Private Prototypes
+ **/
+static int _kernel_supported(void);
+static struct io_uring_sqe * _get_sqe(connmgr_uring_t * ring);
+static int _enter(connmgr_uring_t * ring, unsigned min_complete, unsigned flags, void * arg, size_t arg_size);
+
+/**
+ * Functions
+ **/
+//
+int connmgr_uring_init(connmgr_uring_t * ring, unsigned entries, unsigned buf_count, unsigned buf_size)
+{
+    struct io_uring_params params;
+
+    memset(ring, 0, sizeof(connmgr_uring_t));
+    ring->fd = -1;
+    if(!_kernel_supported() || (buf_count & (buf_count - 1)) != 0 || buf_count > 32768) return CONNMGR_URING_FAILURE;
+
+    memset(&params, 0, sizeof(params));
+    ring->fd = (int) syscall(__NR_io_uring_setup, entries, &params);
+    if(ring->fd == -1) return CONNMGR_URING_FAILURE; // ENOSYS, or io_uring disabled by the administrator
+    if(!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP))
+    {
+        connmgr_uring_free(ring);
+
+        return CONNMGR_URING_FAILURE;
+    }
+
+    ring->sq_size = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+    ring->cq_size = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+    if(params.features & IORING_FEAT_SINGLE_MMAP) ring->sq_size = ring->cq_size = (ring->sq_size > ring->cq_size) ? ring->sq_size : ring->cq_size;
+    ring->sqes_size = params.sq_entries*sizeof(struct io_uring_sqe);
+
+    ring->sq_ptr = mmap(NULL, ring->sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    if(ring->sq_ptr == MAP_FAILED) ring->sq_ptr = NULL;
+    ring->cq_ptr = (params.features & IORING_FEAT_SINGLE_MMAP) ? ring->sq_ptr : mmap(NULL, ring->cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    if(ring->cq_ptr == MAP_FAILED) ring->cq_ptr = NULL;
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    if(ring->sqes == MAP_FAILED) ring->sqes = NULL;
+    if(ring->sq_ptr == NULL || ring->cq_ptr == NULL || ring->sqes == NULL)
+    {
+        connmgr_uring_free(ring);
+
+        return CONNMGR_URING_FAILURE;
+    }
+
+    unsigned char * sq = ring->sq_ptr, * cq = ring->cq_ptr;
+    ring->sq_head = (unsigned *) (sq + params.sq_off.head);
+    ring->sq_tail = (unsigned *) (sq + params.sq_off.tail);
+    ring->sq_mask = (unsigned *) (sq + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned *) (sq + params.sq_off.array);
+    ring->cq_head = (unsigned *) (cq + params.cq_off.head);
+    ring->cq_tail = (unsigned *) (cq + params.cq_off.tail);
+    ring->cq_mask = (unsigned *) (cq + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *) (cq + params.cq_off.cqes);
+    for(unsigned i = 0; i < params.sq_entries; i++) ring->sq_array[i] = i; // entry i always sits in slot i
+
+    size_t buf_ring_size = buf_count*sizeof(struct io_uring_buf); // the tail shares the first entry
+    ring->buf_ring = mmap(NULL, buf_ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0); // page aligned as the kernel wants it
+    ring->bufs = malloc((size_t) buf_count*buf_size);
+    if(ring->buf_ring == MAP_FAILED) ring->buf_ring = NULL;
+    ring->buf_count = buf_count;
+    ring->buf_size = buf_size;
+    if(ring->buf_ring == NULL || ring->bufs == NULL)
+    {
+        connmgr_uring_free(ring);
+
+        return CONNMGR_URING_FAILURE;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t) (uintptr_t) ring->buf_ring;
+    reg.ring_entries = buf_count;
+    reg.bgid = URING_BUF_GROUP;
+    if(syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING, &reg, 1) != 0)
+    {
+        connmgr_uring_free(ring);
+
+        return CONNMGR_URING_FAILURE;
+    }
+    for(unsigned bid = 0; bid < buf_count; bid++) connmgr_uring_buffer_return(ring, (uint16_t) bid);
+
+    return CONNMGR_URING_SUCCESS;
+}
+
+void connmgr_uring_free(connmgr_uring_t * ring)
+{
+    if(ring->fd != -1) close(ring->fd); // cancels whatever is still in flight
+    if(ring->sqes != NULL) munmap(ring->sqes, ring->sqes_size);
+    if(ring->cq_ptr != NULL && ring->cq_ptr != ring->sq_ptr) munmap(ring->cq_ptr, ring->cq_size);
+    if(ring->sq_ptr != NULL) munmap(ring->sq_ptr, ring->sq_size);
+    if(ring->buf_ring != NULL) munmap(ring->buf_ring, ring->buf_count*sizeof(struct io_uring_buf));
+    free(ring->bufs);
+    memset(ring, 0, sizeof(connmgr_uring_t));
+    ring->fd = -1;
+}
+
+void connmgr_uring_accept(connmgr_uring_t * ring, int sd, uint64_t user_data)
+{
+    struct io_uring_sqe * sqe = _get_sqe(ring);
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = sd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT; // one completion per connection until cancelled
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = user_data;
+}
+
+void connmgr_uring_recv(connmgr_uring_t * ring, int sd, uint64_t user_data)
+{
+    struct io_uring_sqe * sqe = _get_sqe(ring);
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = sd;
+    sqe->flags = IOSQE_BUFFER_SELECT; // the kernel picks a provided buffer once data is there
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->ioprio = IORING_RECV_MULTISHOT; // one completion per received chunk until the peer closes or buffers run out
+    sqe->user_data = user_data;
+}
+
+void connmgr_uring_poll(connmgr_uring_t * ring, int fd, uint64_t user_data)
+{
+    struct io_uring_sqe * sqe = _get_sqe(ring);
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = user_data;
+}
+
+void connmgr_uring_cancel(connmgr_uring_t * ring, uint64_t target, uint64_t user_data)
+{
+    struct io_uring_sqe * sqe = _get_sqe(ring);
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target;
+    sqe->user_data = user_data;
+}
+
+int connmgr_uring_wait(connmgr_uring_t * ring, int timeout)
+{
+    struct __kernel_timespec ts = { .tv_sec = timeout/1000, .tv_nsec = (long long) (timeout%1000)*1000000 };
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = (uint64_t) (uintptr_t) &ts;
+
+    if(connmgr_uring_peek(ring) != NULL || timeout == 0) return (ring->sq_pending > 0) ? _enter(ring, 0, 0, NULL, 0) : 0; // completions are waiting already, only submit
+
+    return _enter(ring, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, (timeout < 0) ? NULL : &arg, sizeof(arg));
+}
+
+struct io_uring_cqe * connmgr_uring_peek(connmgr_uring_t * ring)
+{
+    unsigned head = *(ring->cq_head);
+    if(head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) return NULL;
+
+    return &(ring->cqes[head & *(ring->cq_mask)]);
+}
+
+void connmgr_uring_seen(connmgr_uring_t * ring)
+{
+    __atomic_store_n(ring->cq_head, *(ring->cq_head) + 1, __ATOMIC_RELEASE); // the slot may be reused from here on
+}
+
+unsigned connmgr_uring_ready(connmgr_uring_t * ring)
+{
+    return __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) - *(ring->cq_head);
+}
+
+unsigned char * connmgr_uring_buffer(connmgr_uring_t * ring, struct io_uring_cqe * cqe)
+{
+    return &(ring->bufs[(size_t) connmgr_uring_buffer_id(cqe)*ring->buf_size]);
+}
+
+uint16_t connmgr_uring_buffer_id(struct io_uring_cqe * cqe)
+{
+    return (uint16_t) (cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+}
+
+void connmgr_uring_buffer_return(connmgr_uring_t * ring, uint16_t bid)
+{
+    struct io_uring_buf * buf = &(ring->buf_ring->bufs[ring->buf_tail & (ring->buf_count - 1)]);
+    buf->addr = (uint64_t) (uintptr_t) &(ring->bufs[(size_t) bid*ring->buf_size]);
+    buf->len = ring->buf_size;
+    buf->bid = bid;
+    ring->buf_tail++;
+    __atomic_store_n(&(ring->buf_ring->tail), ring->buf_tail, __ATOMIC_RELEASE); // publish after the entry is complete
+}
+
+// Multishot receive arrived in Linux 6.0, the last of the features used here
+static int _kernel_supported(void)
+{
+    struct utsname name;
+    int major = 0, minor = 0;
+
+    if(uname(&name) != 0 || sscanf(name.release, "%d.%d", &major, &minor) != 2) return 0;
+
+    return major >= 6;
+}
+
+// Returns a cleared submission entry, hands the queued ones to the kernel first if the ring is full
+static struct io_uring_sqe * _get_sqe(connmgr_uring_t * ring)
+{
+    unsigned tail = *(ring->sq_tail) + ring->sq_pending;
+
+    while(tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) > *(ring->sq_mask)) // full
+    {
+        _enter(ring, 0, 0, NULL, 0);
+        tail = *(ring->sq_tail) + ring->sq_pending;
+    }
+
+    struct io_uring_sqe * sqe = &(ring->sqes[tail & *(ring->sq_mask)]);
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+    ring->sq_pending++;
+
+    return sqe;
+}
+
+// Publishes the queued entries and submits every entry the kernel did not consume yet
+static int _enter(connmgr_uring_t * ring, unsigned min_complete, unsigned flags, void * arg, size_t arg_size)
+{
+    if(ring->sq_pending > 0) __atomic_store_n(ring->sq_tail, *(ring->sq_tail) + ring->sq_pending, __ATOMIC_RELEASE); // entries are complete, let the kernel see them
+    ring->sq_pending = 0;
+
+    unsigned to_submit = *(ring->sq_tail) - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE); // includes entries a previous call could not submit
+    int res = (int) syscall(__NR_io_uring_enter, ring->fd, to_submit, min_complete, flags, arg, arg_size);
+
+    return (res < 0) ? -errno : 0;
+}
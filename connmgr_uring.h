@@ -0,0 +1,82 @@
+#ifndef _CONNMGR_URING_H_
+#define _CONNMGR_URING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <linux/io_uring.h>
+
+#define CONNMGR_URING_FAILURE -1
+#define CONNMGR_URING_SUCCESS 0
+
+/**
+ * Minimal io_uring instance for the connmgr event loop, set up with the raw system calls
+ * Besides the submission and completion rings it owns one ring of provided buffers (group 0) that
+ * multishot receives pick their buffer from, so no buffer is tied to an idle connection
+ * Only used by the thread that initialized it
+ **/
+typedef struct {
+    int fd;
+    unsigned * sq_head, * sq_tail, * sq_mask, * sq_array;
+    struct io_uring_sqe * sqes;
+    unsigned sq_pending;            // queued entries the submission tail does not cover yet
+    unsigned * cq_head, * cq_tail, * cq_mask;
+    struct io_uring_cqe * cqes;
+    void * sq_ptr, * cq_ptr;
+    size_t sq_size, cq_size, sqes_size;
+    struct io_uring_buf_ring * buf_ring;
+    unsigned char * bufs;
+    unsigned buf_count, buf_size;
+    uint16_t buf_tail;
+} connmgr_uring_t;
+
+/**
+ * Sets up a ring of 'entries' submission entries and registers 'buf_count' provided buffers of
+ * 'buf_size' bytes, 'buf_count' must be a power of 2
+ * Returns CONNMGR_URING_FAILURE if the kernel lacks io_uring or one of the features connmgr relies
+ * on (multishot accept and receive, provided buffer rings, waiting with a timeout), the caller
+ * falls back to another event loop then
+ **/
+int connmgr_uring_init(connmgr_uring_t * ring, unsigned entries, unsigned buf_count, unsigned buf_size);
+
+/**
+ * Releases the ring and its buffers, requests still in flight are cancelled by the kernel
+ **/
+void connmgr_uring_free(connmgr_uring_t * ring);
+
+/**
+ * Queue a multishot accept on 'sd', a multishot receive from 'sd' into provided buffers, a
+ * multishot poll for input on 'fd' or the cancellation of the request tagged 'target'
+ * Nothing reaches the kernel before the next connmgr_uring_wait, unless the submission ring is full
+ **/
+void connmgr_uring_accept(connmgr_uring_t * ring, int sd, uint64_t user_data);
+void connmgr_uring_recv(connmgr_uring_t * ring, int sd, uint64_t user_data);
+void connmgr_uring_poll(connmgr_uring_t * ring, int fd, uint64_t user_data);
+void connmgr_uring_cancel(connmgr_uring_t * ring, uint64_t target, uint64_t user_data);
+
+/**
+ * Submits everything queued and waits up to 'timeout' ms (-1 forever, 0 not at all) for a completion
+ * Returns 0 or -errno, -ETIME if the timeout passed without completions
+ **/
+int connmgr_uring_wait(connmgr_uring_t * ring, int timeout);
+
+/**
+ * Returns the oldest completion not yet seen or NULL, connmgr_uring_seen hands it back to the kernel
+ **/
+struct io_uring_cqe * connmgr_uring_peek(connmgr_uring_t * ring);
+void connmgr_uring_seen(connmgr_uring_t * ring);
+
+/**
+ * Returns the number of completions not yet seen, multishot requests keep adding to them while
+ * they are handled so a loop over only these ends
+ **/
+unsigned connmgr_uring_ready(connmgr_uring_t * ring);
+
+/**
+ * Returns the provided buffer a receive completion 'cqe' filled, the buffer stays with the caller
+ * until connmgr_uring_buffer_return
+ **/
+unsigned char * connmgr_uring_buffer(connmgr_uring_t * ring, struct io_uring_cqe * cqe);
+uint16_t connmgr_uring_buffer_id(struct io_uring_cqe * cqe);
+void connmgr_uring_buffer_return(connmgr_uring_t * ring, uint16_t bid);
+
+#endif /* _CONNMGR_URING_H_ */
@@ -11,6 +11,20 @@
  *                              30/11/2019      1.0           Succesully implemented and completed
  *                                                            libdplist updated and improved
  *                              07/01/2020      2.0           Completed 
+ *                              16/10/2026      2.1           Readings consumed from shared buffer in
+ *                                                            batches of SBUFFER_BATCH_SIZE, waits on
+ *                                                            the buffer instead of yielding when idle
+ *                              16/10/2026      2.2           State is thread local so that every
+ *                                                            shared buffer shard gets its own thread
+ *                              16/10/2026      2.3           Flags shared with the other threads are
+ *                                                            atomics, no locks in the reader loop
+ *                              16/10/2026      2.4           Readings are read in place in the shared
+ *                                                            buffer instead of copied out
+ *                              16/10/2026      2.5           Unknown sensors are dropped through the
+ *                                                            connmgr command queue, once per sensor
+ *                              16/10/2026      2.6           Returns instead of exiting the thread
+ *                                                            when storagemgr failed, so the caller
+ *                                                            still unsubscribes from the shard
  *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
  * TODO                         Date            Finished      Comment
  *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -43,6 +57,7 @@
 #include <inttypes.h>
 #include <stdlib.h>
 #include "datamgr.h"
+#include "connmgr.h"
 
 /**
  * Custom Types
@@ -61,22 +76,21 @@ typedef struct {
 static void * sensor_copy(void * element);
 static void sensor_free(void ** element);
 static int sensor_compare(void * x, void * y);
+static void process_reading(const sensor_data_t * reading);
 
 /**
  * Global Variables
+ * Thread local, every shard of the shared buffer is consumed by its own datamgr thread
  **/
-static dplist_t * dplist;
-static pthread_rwlock_t * sbuffer_open_rwlock;
-static pthread_mutex_t * ipc_pipe_mutex;
-static pthread_rwlock_t * storagemgr_failed_rwlock;
-static pthread_mutex_t * connmgr_drop_conn_mutex;
-static sensor_id_t * connmgr_sensor_to_drop;
-static int * storagemgr_fail_flag;
-static int * sbuffer_open;
-static int * retval;
-static int * pfds;
-static int readby;
-static int num_parsed_data = 0;
+static _Thread_local dplist_t * dplist;
+static _Thread_local pthread_mutex_t * ipc_pipe_mutex;
+static _Thread_local atomic_int * storagemgr_fail_flag;
+static _Thread_local atomic_int * sbuffer_open;
+static _Thread_local int * retval;
+static _Thread_local int * pfds;
+static _Thread_local int readby;
+static _Thread_local int num_parsed_data = 0;
+static _Thread_local int dropped_sensor = CONNMGR_NO_SENSOR; // last sensor connmgr was asked to drop, its readings still in the buffer do not ask again
 
 /**
  * Functions
@@ -84,16 +98,12 @@ static int num_parsed_data = 0;
 //
 void datamgr_init(datamgr_init_arg_t * arg)
 {
-    sbuffer_open_rwlock = arg->sbuffer_rwlock;
     sbuffer_open = arg->sbuffer_flag;
     retval = arg->status;
     readby = arg->id;
     ipc_pipe_mutex = arg->pipe_mutex;
     pfds = arg->ipc_pipe_fd;
-    storagemgr_failed_rwlock = arg->storagemgr_failed_rwlock;
     storagemgr_fail_flag = arg->storagemgr_fail_flag;
-    connmgr_drop_conn_mutex = arg->connmgr_drop_conn_mutex;
-    connmgr_sensor_to_drop = arg->connmgr_sensor_to_drop;
 }
 
 void datamgr_parse_sensor_data(FILE * fp_sensor_map, sbuffer_t ** buffer)
@@ -136,112 +146,102 @@ void datamgr_parse_sensor_data(FILE * fp_sensor_map, sbuffer_t ** buffer)
         write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
     }
     
-    void * node = NULL;
-    dummy.room = 0; // Setting dummy's room ID to NULL to compare elements by sensor ID's instead
-    int sbuffer_res = SBUFFER_SUCCESS;
+    const sensor_data_t * batch[SBUFFER_BATCH_SIZE]; // readings stay in the shared buffer until released
+    int batch_size = 0, open = 1;
 
-    pthread_rwlock_rdlock(storagemgr_failed_rwlock);
-    pthread_rwlock_rdlock(sbuffer_open_rwlock); // lock mutex to sbuffer_open shared data to prevent race condition during checking end of shared buffer
-    while((sbuffer_res != SBUFFER_NO_DATA || *sbuffer_open) && *storagemgr_fail_flag == 0) // use condition variable from writer thread to know when to terminate the readers
+    while((batch_size != 0 || open) && !atomic_load_explicit(storagemgr_fail_flag, memory_order_relaxed)) // use flag from writer thread to know when to terminate the readers
     {
-        pthread_rwlock_unlock(sbuffer_open_rwlock);
-        pthread_rwlock_unlock(storagemgr_failed_rwlock);
-
-        sbuffer_res = sbuffer_pop(*buffer, &node, &(dummy.sensor), readby); // non-blocking, implementation takes care of thread-safety
+        open = atomic_load_explicit(sbuffer_open, memory_order_acquire); // sampled before popping, once it reads 0 all readings are in the buffer
+        batch_size = sbuffer_peek_batch(*buffer, batch, SBUFFER_BATCH_SIZE, readby); // non-blocking, implementation takes care of thread-safety
         
-        if(sbuffer_res != SBUFFER_SUCCESS) pthread_yield();
-        else if(sbuffer_res == SBUFFER_SUCCESS) 
-        {
-            num_parsed_data++;
-
-            #if (DEBUG_LVL > 1)
-            printf("Data Manager: sbuffer data available %"PRIu16" %g %ld\n", dummy.sensor.id, dummy.sensor.value, dummy.sensor.ts);
-            fflush(stdout);
-            #endif
-
-            dplist_node_t * temp = dpl_get_reference_of_element(dplist, &dummy); // Use compare() func to find a list item whose data matches
-            if(temp == NULL) // If no such list item is found, go back to beginning of while-loop
-            {
-                fprintf(stderr, "%" PRIu16 " is not a valid sensor ID\n", dummy.sensor.id); // Log this information to stderr
-                fflush(stderr);
-
-                asprintf(&send_buf, "%ld Data Manager: sensor %" PRIu16 " does not exist", time(NULL), dummy.sensor.id);
-                write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
-                
-                pthread_mutex_lock(connmgr_drop_conn_mutex); 
-                *connmgr_sensor_to_drop = dummy.sensor.id; // signal Connmgr to terminate connection to this socket
-                pthread_mutex_unlock(connmgr_drop_conn_mutex);
-
-                pthread_rwlock_rdlock(storagemgr_failed_rwlock);
-                pthread_rwlock_rdlock(sbuffer_open_rwlock);
-                continue;
-            }
-            
-            node_t * list_el = dpl_get_element_of_reference(temp); // Abstraction from incomplete data type dplist_node_t which is not accessible to us -> returns our custom data element type
-            list_el->sensor.ts = dummy.sensor.ts; // Update the "Last Modified" stamp
-            sensor_value_t sum = 0; // Accumulate the measurements and find average reading
-            for(int i = RUN_AVG_LENGTH-1; i >= 0; i--) // Shift array elements (circular buffer style)
-            {
-                if(i != 0) list_el->msrmnts[i] = list_el->msrmnts[i-1];
-                if(i == 0) list_el->msrmnts[i] = dummy.sensor.value;
-                sum += list_el->msrmnts[i]; // Accumulate
-            }
-            
-            if(list_el->num_msrmnts < RUN_AVG_LENGTH-1) // If less than running average of measurements were taken, average is 0
-            {
-                (list_el->num_msrmnts)++;
-                list_el->sensor.value = 0;
-
-                pthread_rwlock_rdlock(storagemgr_failed_rwlock);
-                pthread_rwlock_rdlock(sbuffer_open_rwlock);
-                continue; // If total measurement number is less than RUN_AVG_LENGTH, skip accumulation
-            }
-            
-            list_el->sensor.value = sum/RUN_AVG_LENGTH; // Get average
-            if(list_el->sensor.value < SET_MIN_TEMP) 
-            {
-                fprintf(stderr, "Sensor %" PRIu16 " in Room %" PRIu16 " detected temperature below %g *C limit of %g *C at %ld\n", list_el->sensor.id, list_el->room, (double) SET_MIN_TEMP, list_el->sensor.value, list_el->sensor.ts);
-                fflush(stderr);
-
-                asprintf(&send_buf, "%ld Data Manager: sensor %" PRIu16 " in room %" PRIu16 " - too cold %g below %g", time(NULL), list_el->sensor.id, list_el->room, list_el->sensor.value, (double) SET_MIN_TEMP);
-                
-                write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
-            } else if(list_el->sensor.value > SET_MAX_TEMP) 
-            {
-                fprintf(stderr, "Sensor %" PRIu16 " in Room %" PRIu16 " detected temperature above %g *C limit of %g *C at %ld\n", list_el->sensor.id, list_el->room, (double) SET_MAX_TEMP, list_el->sensor.value, list_el->sensor.ts);
-                fflush(stderr);
-
-                asprintf(&send_buf, "%ld Data Manager: sensor %" PRIu16 " in room %" PRIu16 " - too hot %g above %g", time(NULL), list_el->sensor.id, list_el->room, list_el->sensor.value, (double) SET_MAX_TEMP);
-                
-                write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
-            }
-        }
+        if(batch_size == SBUFFER_FAILURE) break; // not subscribed, nothing will ever come
+        if(batch_size < 0 || (batch_size == 0 && open)) sbuffer_wait(*buffer, readby, SBUFFER_WAIT_TIMEOUT); // park until connmgr inserts data or closes the buffer
+        for(int i = 0; i < batch_size; i++) process_reading(batch[i]);
+        if(batch_size > 0) sbuffer_release(*buffer, readby);
 
         // usleep(100000);
-
-        pthread_rwlock_rdlock(storagemgr_failed_rwlock);
-        pthread_rwlock_rdlock(sbuffer_open_rwlock); // lock mutex to sbuffer_open shared data to prevent race condition during checking end of shared buffer
     }
-    pthread_rwlock_unlock(sbuffer_open_rwlock);
 
-    if(*storagemgr_fail_flag)
+    if(atomic_load(storagemgr_fail_flag))
     {
-        pthread_rwlock_unlock(storagemgr_failed_rwlock);
-
         *retval = DATAMGR_INTERRUPTED_BY_STORAGEMGR;
 
         asprintf(&send_buf, "%ld Data Manager: signalled to terminate by Storage Manager", time(NULL));
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf); // the caller unsubscribes and cleans up as after a regular end
+    }
+}
+
+// Updates the running average of the sensor the reading belongs to and logs out of range averages
+static void process_reading(const sensor_data_t * reading)
+{
+    node_t dummy;
+    char * send_buf;
+
+    num_parsed_data++;
+
+    #if (DEBUG_LVL > 1)
+    printf("Data Manager: sbuffer data available %"PRIu16" %g %ld\n", reading->id, reading->value, reading->ts);
+    fflush(stdout);
+    #endif
+
+    dummy.room = 0; // Setting dummy's room ID to NULL to compare elements by sensor ID's instead
+    dummy.sensor = *reading;
+    dplist_node_t * temp = dpl_get_reference_of_element(dplist, &dummy); // Use compare() func to find a list item whose data matches
+    if(temp == NULL) // If no such list item is found, go back to beginning of while-loop
+    {
+        fprintf(stderr, "%" PRIu16 " is not a valid sensor ID\n", reading->id); // Log this information to stderr
+        fflush(stderr);
+
+        asprintf(&send_buf, "%ld Data Manager: sensor %" PRIu16 " does not exist", time(NULL), reading->id);
         write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+        
+        if(reading->id == dropped_sensor) return;
+        dropped_sensor = reading->id;
+        if(connmgr_command(CONNMGR_CMD_DROP, reading->id, 0) == -1) // signal Connmgr to terminate connection to this socket
+        {
+            asprintf(&send_buf, "%ld Data Manager: connmgr command queue full, sensor %" PRIu16 " not dropped", time(NULL), reading->id);
+            write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+        }
 
-        datamgr_free();
+        return;
+    }
+    
+    node_t * list_el = dpl_get_element_of_reference(temp); // Abstraction from incomplete data type dplist_node_t which is not accessible to us -> returns our custom data element type
+    list_el->sensor.ts = reading->ts; // Update the "Last Modified" stamp
+    sensor_value_t sum = 0; // Accumulate the measurements and find average reading
+    for(int i = RUN_AVG_LENGTH-1; i >= 0; i--) // Shift array elements (circular buffer style)
+    {
+        if(i != 0) list_el->msrmnts[i] = list_el->msrmnts[i-1];
+        if(i == 0) list_el->msrmnts[i] = reading->value;
+        sum += list_el->msrmnts[i]; // Accumulate
+    }
+    
+    if(list_el->num_msrmnts < RUN_AVG_LENGTH-1) // If less than running average of measurements were taken, average is 0
+    {
+        (list_el->num_msrmnts)++;
+        list_el->sensor.value = 0;
 
-        #if (DEBUG_LVL > 0)
-        printf("Data Manager is stopped\n");
-        fflush(stdout);
-        #endif
+        return; // If total measurement number is less than RUN_AVG_LENGTH, skip accumulation
+    }
+    
+    list_el->sensor.value = sum/RUN_AVG_LENGTH; // Get average
+    if(list_el->sensor.value < SET_MIN_TEMP) 
+    {
+        fprintf(stderr, "Sensor %" PRIu16 " in Room %" PRIu16 " detected temperature below %g *C limit of %g *C at %ld\n", list_el->sensor.id, list_el->room, (double) SET_MIN_TEMP, list_el->sensor.value, list_el->sensor.ts);
+        fflush(stderr);
 
-        pthread_exit(retval);
-    } else pthread_rwlock_unlock(storagemgr_failed_rwlock);
+        asprintf(&send_buf, "%ld Data Manager: sensor %" PRIu16 " in room %" PRIu16 " - too cold %g below %g", time(NULL), list_el->sensor.id, list_el->room, list_el->sensor.value, (double) SET_MIN_TEMP);
+        
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+    } else if(list_el->sensor.value > SET_MAX_TEMP) 
+    {
+        fprintf(stderr, "Sensor %" PRIu16 " in Room %" PRIu16 " detected temperature above %g *C limit of %g *C at %ld\n", list_el->sensor.id, list_el->room, (double) SET_MAX_TEMP, list_el->sensor.value, list_el->sensor.ts);
+        fflush(stderr);
+
+        asprintf(&send_buf, "%ld Data Manager: sensor %" PRIu16 " in room %" PRIu16 " - too hot %g above %g", time(NULL), list_el->sensor.id, list_el->room, list_el->sensor.value, (double) SET_MAX_TEMP);
+        
+        write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+    }
 }
 
 void datamgr_free()
@@ -341,6 +341,7 @@ void datamgr_print_summary()
     for(dplist_node_t * dummy = dpl_get_first_reference(dplist); dummy != NULL; dummy = dpl_get_next_reference(dplist, dummy))
     {
         node_t * node = dpl_get_element_of_reference(dummy);
+        if(SBUFFER_SHARDS > 1 && node->sensor.ts == 0) continue; // sensor of another shard
         printf("\n********Room %" PRIu16 " - Sensor %" PRIu16 "********\nCurrent average reading = %g *C\nLast modified: %ld\nLast measurements (DESC):\n", node->room, node->sensor.id, node->sensor.value, node->sensor.ts);
         fflush(stdout);
         for(int i = 0; i < RUN_AVG_LENGTH; i++) 
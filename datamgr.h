@@ -68,7 +68,8 @@ void datamgr_print_summary();
 
 /**
  * This method shares variables from threads space to carry out more functionality,
- * like having access to IPC mutex/rwlock and updating the return value of the thread
+ * like having access to IPC mutex and the atomic flags shared between threads and updating
+ * the return value of the thread
  **/
 void datamgr_init(datamgr_init_arg_t * arg);
 
@@ -52,8 +52,9 @@ struct tcpsock {
 };
 
 static tcpsock_t * tcp_sock_create();  
+static int tcp_passive_open_opt(tcpsock_t ** sock, int port, int reuse_port);
   
-int tcp_passive_open(tcpsock_t ** sock, int port)
+static int tcp_passive_open_opt(tcpsock_t ** sock, int port, int reuse_port)
 {
     int result;
     struct sockaddr_in addr;
@@ -68,6 +69,12 @@ int tcp_passive_open(tcpsock_t ** sock, int port)
     addr.sin_family = PROTOCOLFAMILY;
     addr.sin_addr.s_addr = htonl(INADDR_ANY);
     addr.sin_port = htons(port);
+    if (reuse_port)
+    {
+      result = setsockopt(s->sd, SOL_SOCKET, SO_REUSEPORT, &reuse_port, sizeof(reuse_port));
+      TCP_DEBUG_PRINTF(result == -1, "Setsockopt() failed with errno = %d [%s]", errno, strerror(errno));
+      TCP_ERR_HANDLER(result != 0, close(s->sd); free(s); return TCP_SOCKOP_ERROR);
+    }
     result = bind(s->sd, (struct sockaddr *) &addr, sizeof(addr));
     TCP_DEBUG_PRINTF(result == -1, "Bind() failed with errno = %d [%s]", errno, strerror(errno));
     TCP_ERR_HANDLER(result != 0, free(s); return TCP_SOCKOP_ERROR);   
@@ -81,6 +88,16 @@ int tcp_passive_open(tcpsock_t ** sock, int port)
     return TCP_NO_ERROR;  
 }
 
+int tcp_passive_open(tcpsock_t ** sock, int port)
+{
+    return tcp_passive_open_opt(sock, port, 0);
+}
+
+int tcp_passive_open_shared(tcpsock_t ** sock, int port)
+{
+    return tcp_passive_open_opt(sock, port, 1);
+}
+
 int tcp_active_open(tcpsock_t ** sock, int remote_port, char * remote_ip)
 {
     struct sockaddr_in addr;
@@ -28,6 +28,11 @@ int tcp_passive_open(tcpsock_t ** socket, int port);
  * If a socket operation (socket, listen, bind, accept,...) fails, TCP_SOCKOP_ERROR is returned
  */
 
+int tcp_passive_open_shared(tcpsock_t ** socket, int port);
+/* Same as tcp_passive_open, but SO_REUSEPORT is set on the socket before it is bound
+ * Several sockets opened this way can listen on the same 'port', the kernel spreads incoming connections over them
+ */
+
 int tcp_active_open(tcpsock_t ** socket, int remote_port, char * remote_ip);
 /* Creates a new TCP socket and opens a TCP connection to the system with IP address 'remote_ip' on port 'remote_port'
  * The newly created socket is return as '*socket'
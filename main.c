@@ -19,6 +19,22 @@
  *                                                                  sensor is registered with Data Manager and
  *                                                                  to also log which sensor connected on TCP
  *                                                                  connection for readability of log file           
+ *                                  16/10/2026      1.1             One datamgr and storagemgr thread per
+ *                                                                  shard of the shared buffer (SBUFFER_SHARDS)
+ *                                  16/10/2026      1.2             Shutdown/failure flags are atomics instead
+ *                                                                  of rwlock/mutex guarded ints, changes are
+ *                                                                  signalled on an eventfd connmgr polls
+ *                                  16/10/2026      1.3             room_sensor.map is loaded into a bitmap
+ *                                                                  of sensor ids once, connmgr refuses the
+ *                                                                  sensors that are not in it
+ *                                  16/10/2026      1.4             Drop requests go through the connmgr
+ *                                                                  command queue, SIGHUP makes connmgr
+ *                                                                  re-read room_sensor.map
+ *                                  16/10/2026      1.5             A storagemgr that could not commit a
+ *                                                                  batch stops the gateway like one that
+ *                                                                  could not connect
+ *                                  16/10/2026      1.6             Startup stops if a reader cannot
+ *                                                                  subscribe to its shard
  *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
  * TODO                             Date            Finished        Comment
  *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -77,6 +93,8 @@
 #include <pthread.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/eventfd.h>
+#include <signal.h>
 #include <poll.h>
 #include <inttypes.h>
 #include <assert.h>
@@ -88,29 +106,27 @@
 #include "sensor_db.h"
 #include "connmgr.h"
 #include "sbuffer.h"
+#include "sbuffer_shard.h"
 #include "lib/tcpsock.h"
-#include "lib/dplist.h"
 
 /**
  * Custom Types
  **/
-struct tcpsock_dpl_el {     // Custom element to use with my dplist implementation to be able to use compare() call
-    tcpsock_t * sock_ptr;   // to and create dummy to compare with (tcpsock_t is incomplete data type otherwise, hence
-    int sd;                 // can't create a dummy with a given sd to use in compare())
-    sensor_ts_t last_active;
-};
+typedef struct {            // argument of the datamgr and storagemgr threads
+    int shard;              // index of the shared buffer shard the thread consumes
+    int readby;             // reader handle within that shard
+} reader_arg_t;
 
 /**
  * Global Variables
  **/
-static pthread_rwlock_t sbuffer_open_rwlock;
 static pthread_mutex_t ipc_pipe_mutex; // use as mutex to IPC pipe for logging
-static pthread_mutex_t connmgr_drop_conn_mutex;
-static pthread_rwlock_t storagemgr_failed_rwlock;
-static sbuffer_t * buffer; // incomplete data type, all logic and synchronization of buffer is taken care of in sbuffer implementation
-static sensor_id_t connmgr_sensor_to_drop = 0;
-static int sbuffer_open = 1;
-static int storagemgr_failed = 0;
+static sbuffer_shard_t * buffer; // incomplete data type, all logic and synchronization of buffer is taken care of in sbuffer implementation
+static pthread_barrier_t storagemgr_ready; // storagemgr of shard 0 (re)creates the table before the others connect
+static atomic_int sbuffer_open = 1;
+static atomic_int storagemgr_failed = 0;
+static _Atomic uint64_t sensor_map[SENSOR_MAP_WORDS]; // sensors registered in room_sensor.map, rewritten by connmgr on SIGHUP
+static int ctl_efd; // signalled whenever one of the flags above changes
 static int pfds[2];
 
 /**
@@ -119,6 +135,7 @@ static int pfds[2];
 void * connmgr(void * arg);
 void * datamgr(void * arg);
 void * storagemgr(void * arg);
+void * signal_handler(void * arg);
 void print_help(void);
 
 /**
@@ -161,6 +178,7 @@ int main(int argc, char *argv[])
     if(child_pid == 0) // Child's Code
     {
         close(pfds[1]); // Child does not need writing end
+        signal(SIGHUP, SIG_IGN); // a SIGHUP to the process group is a reload for the gateway, the logger keeps running
 
         FILE * log_data = fopen("gateway.log", "w");
         FILE_OPEN_ERROR(log_data);
@@ -216,21 +234,50 @@ int main(int argc, char *argv[])
     pthread_t threads[NUM_THREADS];
     void * exit_codes[NUM_THREADS]; // array of pointers to thread returns
 
-    sbuffer_init(&buffer);
-    pthread_rwlock_init(&sbuffer_open_rwlock, NULL);
-    pthread_rwlock_init(&storagemgr_failed_rwlock, NULL);
-    pthread_mutex_init(&connmgr_drop_conn_mutex, NULL);
+    ctl_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    SYSCALL_ERROR(ctl_efd);
+    SYSCALL_ERROR(connmgr_load_sensor_map(sensor_map));
+
+    pthread_t signal_thread;
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGHUP);
+    pthread_sigmask(SIG_BLOCK, &signals, NULL); // inherited by every thread, only signal_thread takes SIGHUP
+    pthread_create(&signal_thread, NULL, &signal_handler, &signals);
+    if(sbuffer_shard_init(&buffer, SBUFFER_SHARDS) != SBUFFER_SUCCESS)
+    {
+        fprintf(stderr, "Shared buffer could not be created\n");
+        exit(EXIT_FAILURE);
+    }
+    pthread_barrier_init(&storagemgr_ready, NULL, SBUFFER_SHARDS);
 
-    int arg0 = 0, arg1 = 1, arg2 = server_port;
+    reader_arg_t datamgr_args[SBUFFER_SHARDS], storagemgr_args[SBUFFER_SHARDS];
+    int connmgr_arg = server_port;
 
-    pthread_create(&(threads[0]), NULL, &datamgr, &arg0);
-    pthread_create(&(threads[1]), NULL, &storagemgr, &arg1);
-    pthread_create(&(threads[2]), NULL, &connmgr, &arg2);
+    for(int i = 0; i < SBUFFER_SHARDS; i++) // readers subscribe before any thread starts so they do not miss the first readings
+    {
+        datamgr_args[i].shard = storagemgr_args[i].shard = i;
+        if(sbuffer_subscribe(sbuffer_shard_get(buffer, i), &(datamgr_args[i].readby)) != SBUFFER_SUCCESS || sbuffer_subscribe(sbuffer_shard_get(buffer, i), &(storagemgr_args[i].readby)) != SBUFFER_SUCCESS)
+        {
+            fprintf(stderr, "Shard %d of the shared buffer has no free reader slot\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    for(int i = 0; i < SBUFFER_SHARDS; i++) // threads [0, SBUFFER_SHARDS) are datamgr's, then storagemgr's, connmgr is last
+    {
+        pthread_create(&(threads[i]), NULL, &datamgr, &(datamgr_args[i]));
+        pthread_create(&(threads[SBUFFER_SHARDS+i]), NULL, &storagemgr, &(storagemgr_args[i]));
+    }
+    pthread_create(&(threads[NUM_THREADS-1]), NULL, &connmgr, &connmgr_arg);
 
     for(int i = 0; i < NUM_THREADS; i++) pthread_join(threads[i], &exit_codes[i]); // blocks until all threads terminate
+    pthread_cancel(signal_thread); // waits in sigwait, a cancellation point
+    pthread_join(signal_thread, NULL);
 
     #if (DEBUG_LVL > 0)
-    printf("Threads stopped. Cleaning up\nThread exit result:\n"CHILD_POS"Data Manager: %d\n"CHILD_POS"Storage Manager %d\n"CHILD_POS"Connection Manager: %d\n", *((int *) exit_codes[0]), *((int *) exit_codes[1]), *((int *) exit_codes[2]));
+    printf("Threads stopped. Cleaning up\nThread exit result:\n");
+    for(int i = 0; i < SBUFFER_SHARDS; i++) printf(CHILD_POS"Data Manager %d: %d\n"CHILD_POS"Storage Manager %d: %d\n", i, *((int *) exit_codes[i]), i, *((int *) exit_codes[SBUFFER_SHARDS+i]));
+    printf(CHILD_POS"Connection Manager: %d\n", *((int *) exit_codes[NUM_THREADS-1]));
     fflush(stdout);
     #endif
 
@@ -240,13 +287,13 @@ int main(int argc, char *argv[])
     #if (DEBUG_LVL > 0)
     printf("Child process stopped. Cleaning up\n");
     fflush(stdout);
+    sbuffer_shard_print_content(buffer); // leftovers and allocator counters of the shared buffer
     #endif
 
-    sbuffer_free(&buffer);
-    pthread_rwlock_destroy(&sbuffer_open_rwlock);
+    sbuffer_shard_free(&buffer);
+    pthread_barrier_destroy(&storagemgr_ready);
     pthread_mutex_destroy(&ipc_pipe_mutex);
-    pthread_mutex_destroy(&connmgr_drop_conn_mutex);
-    pthread_rwlock_destroy(&storagemgr_failed_rwlock);
+    close(ctl_efd);
     
     for(int i = 0; i < NUM_THREADS; i++) free(exit_codes[i]); // release memory alloc'ed to exit codes
 
@@ -258,6 +305,8 @@ void * datamgr(void * arg)
     int * retval = malloc(sizeof(int));
     *retval = THREAD_SUCCESS;
     FILE * fp_sensor_map = fopen("room_sensor.map", "r");
+    reader_arg_t * reader = (reader_arg_t *) arg;
+    sbuffer_t * shard = sbuffer_shard_get(buffer, reader->shard);
 
     #if (DEBUG_LVL > 0)
     printf("Data Manager is started\n");
@@ -265,23 +314,20 @@ void * datamgr(void * arg)
     #endif
 
     datamgr_init_arg_t datamgr_init_arg = {
-        .sbuffer_rwlock = &sbuffer_open_rwlock,
         .pipe_mutex = &ipc_pipe_mutex,
         .sbuffer_flag = &sbuffer_open,
         .storagemgr_fail_flag = &storagemgr_failed,
-        .storagemgr_failed_rwlock = &storagemgr_failed_rwlock,
-        .connmgr_drop_conn_mutex = &connmgr_drop_conn_mutex,
-        .connmgr_sensor_to_drop = &connmgr_sensor_to_drop,
         .ipc_pipe_fd = pfds,
         .status = retval,
-        .id = *((int*) arg),
+        .id = reader->readby,
     };
 
     datamgr_init(&datamgr_init_arg);
-    datamgr_parse_sensor_data(fp_sensor_map, &buffer);
+    datamgr_parse_sensor_data(fp_sensor_map, &shard);
     int ret_listen = *retval; // in between these calls, the retval maybe different. it maybe interesting to know the value in both
     datamgr_print_summary();
     datamgr_free();
+    sbuffer_unsubscribe(shard, reader->readby); // connmgr must not keep readings around for a reader that is gone
     *retval = (ret_listen != THREAD_SUCCESS && ret_listen != *retval) ? ret_listen: *retval; // in case the thread value was affected by listen and then free, show the first
     
     fclose(fp_sensor_map);
@@ -300,6 +346,8 @@ void * storagemgr(void * arg)
     *retval = THREAD_SUCCESS;
     DBCONN * db;
     int attempts = 0;
+    reader_arg_t * reader = (reader_arg_t *) arg;
+    sbuffer_t * shard = sbuffer_shard_get(buffer, reader->shard);
 
     #if (DEBUG_LVL > 0)
     printf("Storage Manager is started\n");
@@ -307,25 +355,26 @@ void * storagemgr(void * arg)
     #endif
 
     storagemgr_init_arg_t storagemgr_init_arg = {
-        .sbuffer_rwlock = &sbuffer_open_rwlock,
         .pipe_mutex = &ipc_pipe_mutex,
         .sbuffer_flag = &sbuffer_open,
         .ipc_pipe_fd = pfds,
         .status = retval,
-        .id = *((int*) arg),
+        .id = reader->readby,
     };
 
     storagemgr_init(&storagemgr_init_arg);
     
+    if(reader->shard != 0) pthread_barrier_wait(&storagemgr_ready); // only connect once the table was cleared up
     do {
-        db = init_connection(1);
+        db = init_connection(reader->shard == 0);
         attempts++;
         if(db == NULL) pthread_yield();
     } while(attempts < STORAGE_INIT_ATTEMPTS && db == NULL); // attempt to connect to DB n times
+    if(reader->shard == 0) pthread_barrier_wait(&storagemgr_ready);
 
     if(db != NULL)
     {
-        storagemgr_parse_sensor_data(db, &buffer);
+        storagemgr_parse_sensor_data(db, &shard);
         int ret_listen = *retval; // in between these calls, the retval maybe different. it maybe interesting to know the value in both
         disconnect(db);
         *retval = (ret_listen != THREAD_SUCCESS && ret_listen != *retval) ? ret_listen: *retval; // in case the thread value was affected by listen and then free, show the first   
@@ -334,11 +383,14 @@ void * storagemgr(void * arg)
         char * send_buf;
         asprintf(&send_buf, "%ld Storage Manager: Failed to start DB server %d times, exitting", time(NULL), STORAGE_INIT_ATTEMPTS);
         write_to_pipe(&ipc_pipe_mutex, pfds, send_buf);
-
-        pthread_rwlock_wrlock(&storagemgr_failed_rwlock); // signal other threades to terminate by changing shared data value
-        storagemgr_failed = 1;
-        pthread_rwlock_unlock(&storagemgr_failed_rwlock);
     }
+    if(*retval != THREAD_SUCCESS || db == NULL) // readings can no longer be stored
+    {
+        atomic_store(&storagemgr_failed, 1); // signal other threades to terminate by changing shared data value
+        write_to_event(&ctl_efd); // connmgr may be sitting in poll
+        sbuffer_shard_wakeup(buffer); // Data Managers may be parked on an empty buffer
+    }
+    sbuffer_unsubscribe(shard, reader->readby);
 
     #if (DEBUG_LVL > 0)
     printf("Storage Manager is stopped\n");
@@ -359,19 +411,17 @@ void * connmgr(void * arg)
     #endif
 
     connmgr_init_arg_t connmgr_init_arg = {
-        .sbuffer_rwlock = &sbuffer_open_rwlock,
         .pipe_mutex = &ipc_pipe_mutex,
         .sbuffer_flag = &sbuffer_open,
         .storagemgr_fail_flag = &storagemgr_failed,
-        .storagemgr_failed_rwlock = &storagemgr_failed_rwlock,
-        .connmgr_drop_conn_mutex = &connmgr_drop_conn_mutex,
-        .connmgr_sensor_to_drop = &connmgr_sensor_to_drop,
+        .sensor_map = sensor_map,
+        .ctl_event_fd = &ctl_efd,
         .ipc_pipe_fd = pfds,
         .status = retval,
     };
 
     connmgr_init(&connmgr_init_arg);
-    connmgr_listen(*((int*) arg), &buffer);
+    connmgr_listen(*((int*) arg), buffer);
     int ret_listen = *retval; // in between these calls, the retval maybe different. it maybe interesting to know the value in both
     connmgr_free();
     *retval = (ret_listen != THREAD_SUCCESS && ret_listen != *retval) ? ret_listen: *retval; // in case the thread value was affected by listen and then free, show the first
@@ -384,6 +434,25 @@ void * connmgr(void * arg)
     pthread_exit(retval);
 }
 
+// Takes the signals blocked in all other threads, SIGHUP has connmgr re-read room_sensor.map
+void * signal_handler(void * arg)
+{
+    sigset_t * signals = (sigset_t *) arg;
+    int sig;
+
+    while(sigwait(signals, &sig) == 0)
+    {
+        if(sig == SIGHUP && connmgr_command(CONNMGR_CMD_RELOAD, CONNMGR_NO_SENSOR, 0) == -1)
+        {
+            char * send_buf;
+            asprintf(&send_buf, "%ld Gateway: connmgr command queue full, room_sensor.map not re-read", time(NULL));
+            write_to_pipe(&ipc_pipe_mutex, pfds, send_buf);
+        }
+    }
+
+    return NULL;
+}
+
 void print_help(void)
 {
     printf("Use this program with 1 command line options: \n");
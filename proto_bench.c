@@ -0,0 +1,241 @@
+/***************************************************************************************************
+ *
+ * FileName:        proto_bench.c
+ * Comment:         Benchmark of the reading encodings of the wire protocol, size on the wire and
+ *                  decode throughput of the same readings in every encoding
+ * Dependencies:    Header (.h) files sensor_proto.h, built by 'make bench-proto'
+ *
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Author                       Date            Version       Comment
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Maxim Yudayev                16/10/2026      1.0           Readings follow the random walk of
+ *                                                            sensor_node, v1 is the baseline
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * Usage: proto_bench [-n readings] [-b readings per frame] [-i seconds between readings]
+ * [-q value step, 0 keeps full precision] [-r decode rounds]
+ * Bytes per reading include the frame headers (the hello is left out), decode throughput is that of
+ * proto_decode over frames already in memory, as connmgr runs it on a receive buffer.
+ *
+ ***************************************************************************************************/
+
+/**
+ * Includes
+ **/
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <time.h>
+#include "config.h"
+#include "sensor_proto.h"
+
+#define INITIAL_TEMPERATURE 20
+#define TEMP_DEV 5 // same walk as sensor_node
+
+/**
+ * Global Variables
+ **/
+static long readings = 1000000;
+static int batch = 16, interval = 1, rounds = 10;
+static double step = 0;
+static sensor_data_t * data;
+static unsigned char * wire;
+
+/**
+ * Private Prototypes
+ **/
+static size_t _encode(uint8_t encoding);
+static int _decode(uint8_t encoding, size_t size, double * max_error);
+static size_t _encode_v1(void);
+static void _decode_v1(size_t size);
+static uint64_t _now_ns(void);
+
+/**
+ * Functions
+ **/
+//
+int main(int argc, char *argv[])
+{
+    int opt;
+    const char * names[] = { "raw", "xor", "fixed" };
+
+    while((opt = getopt(argc, argv, "n:b:i:q:r:")) != -1)
+    {
+        switch(opt)
+        {
+            case 'n': readings = atol(optarg); break;
+            case 'b': batch = atoi(optarg); break;
+            case 'i': interval = atoi(optarg); break;
+            case 'q': step = atof(optarg); break;
+            case 'r': rounds = atoi(optarg); break;
+            default:
+                fprintf(stderr, "Usage: %s [-n readings] [-b readings per frame] [-i seconds between readings] [-q value step] [-r decode rounds]\n", argv[0]);
+                exit(EXIT_FAILURE);
+        }
+    }
+    if(readings < 1 || batch < 1 || batch > PROTO_FRAME_MAX || interval < 0 || step < 0 || rounds < 1)
+    {
+        fprintf(stderr, "Invalid arguments, at most %d readings per frame\n", PROTO_FRAME_MAX);
+        exit(EXIT_FAILURE);
+    }
+
+    data = (sensor_data_t *) malloc(sizeof(sensor_data_t)*readings);
+    wire = (unsigned char *) malloc((PROTO_HEADER_SIZE + PROTO_MAX_READING_SIZE)*readings); // enough for a frame per reading in any encoding
+    if(data == NULL || wire == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    srand48(1);
+    for(long i = 0; i < readings; i++)
+    {
+        data[i].id = 1;
+        data[i].value = (i == 0) ? INITIAL_TEMPERATURE : data[i-1].value + TEMP_DEV * ((drand48() - 0.5)/10);
+        data[i].ts = (sensor_ts_t) 1700000000 + (sensor_ts_t) i*interval;
+    }
+    if(step > 0) for(long i = 0; i < readings; i++) data[i].value = (long) (data[i].value/step + 0.5)*step; // as read from an ADC
+
+    printf("%ld readings, %d per frame, %d s apart, ", readings, batch, interval);
+    if(step > 0) printf("values in steps of %g\n", step);
+    else printf("values at full precision\n");
+    printf("%-8s %10s %10s %14s %10s\n", "encoding", "bytes", "B/reading", "decode/s", "max error");
+
+    size_t size = _encode_v1();
+    uint64_t start = _now_ns();
+    for(int r = 0; r < rounds; r++) _decode_v1(size);
+    double elapsed = (double) (_now_ns() - start)/1e9;
+    printf("%-8s %10zu %10.2f %14.0f %10g\n", "v1", size, (double) size/readings, (double) readings*rounds/elapsed, 0.0);
+
+    for(uint8_t encoding = PROTO_ENC_RAW; encoding <= PROTO_ENC_FIXED; encoding++)
+    {
+        double max_error = 0;
+        size = _encode(encoding);
+        start = _now_ns();
+        for(int r = 0; r < rounds; r++)
+        {
+            if(_decode(encoding, size, &max_error) != 0)
+            {
+                fprintf(stderr, "%s: decoded readings do not match\n", names[encoding]);
+                exit(EXIT_FAILURE);
+            }
+        }
+        elapsed = (double) (_now_ns() - start)/1e9;
+        printf("%-8s %10zu %10.2f %14.0f %10g\n", names[encoding], size, (double) size/readings, (double) readings*rounds/elapsed, max_error);
+    }
+
+    free(data);
+    free(wire);
+
+    return EXIT_SUCCESS;
+}
+
+// Encodes all readings in frames of 'batch' readings like sensor_node, returns the bytes on the wire
+static size_t _encode(uint8_t encoding)
+{
+    proto_codec_t codec;
+    size_t pos = 0;
+
+    for(long first = 0; first < readings; first += batch)
+    {
+        uint16_t count = (readings - first < batch) ? (uint16_t) (readings - first) : (uint16_t) batch;
+        size_t header = pos;
+        uint16_t length;
+
+        proto_codec_init(&codec, encoding, data[first].ts);
+        pos += PROTO_HEADER_SIZE;
+        for(long i = first; i < first + count; i++) pos += proto_encode(&codec, &wire[pos], data[i].value, data[i].ts);
+
+        length = (uint16_t) (pos - header - sizeof(length));
+        memcpy(&wire[header], &length, sizeof(length));
+        header += sizeof(length);
+        memcpy(&wire[header], &encoding, sizeof(encoding));
+        header += sizeof(encoding);
+        memcpy(&wire[header], &(data[first].id), sizeof(sensor_id_t));
+        header += sizeof(sensor_id_t);
+        memcpy(&wire[header], &count, sizeof(count));
+        header += sizeof(count);
+        memcpy(&wire[header], &(data[first].ts), sizeof(sensor_ts_t));
+    }
+
+    return pos;
+}
+
+// Decodes the frames in 'wire' and compares them with the readings, returns -1 on a mismatch
+static int _decode(uint8_t encoding, size_t size, double * max_error)
+{
+    proto_codec_t codec;
+    size_t pos = 0;
+    long i = 0;
+    double tolerance = (encoding == PROTO_ENC_FIXED) ? 0.5/PROTO_FIXED_SCALE + 1e-9 : 0;
+
+    while(pos < size)
+    {
+        uint16_t length, count;
+        sensor_ts_t base_ts;
+        memcpy(&length, &wire[pos], sizeof(length));
+        memcpy(&count, &wire[pos + sizeof(length) + sizeof(uint8_t) + sizeof(sensor_id_t)], sizeof(count));
+        memcpy(&base_ts, &wire[pos + PROTO_HEADER_SIZE - sizeof(sensor_ts_t)], sizeof(base_ts));
+        proto_codec_init(&codec, encoding, base_ts);
+
+        int left = length - (int) (PROTO_HEADER_SIZE - sizeof(length)), used;
+        unsigned char * field = &wire[pos + PROTO_HEADER_SIZE];
+        for(int n = 0; n < count; n++, i++, field += used, left -= used)
+        {
+            sensor_value_t value;
+            sensor_ts_t ts;
+            if((used = proto_decode(&codec, field, left, &value, &ts)) == PROTO_FAILURE) return -1;
+
+            double error = (value > data[i].value) ? value - data[i].value : data[i].value - value;
+            if(ts != data[i].ts || error > tolerance) return -1;
+            if(error > *max_error) *max_error = error;
+        }
+        pos += sizeof(length) + length;
+    }
+
+    return (i == readings) ? 0 : -1;
+}
+
+// Packs the readings one by one as <sensor_id><value><timestamp>, returns the bytes on the wire
+static size_t _encode_v1(void)
+{
+    size_t pos = 0;
+    for(long i = 0; i < readings; i++)
+    {
+        memcpy(&wire[pos], &(data[i].id), sizeof(data[i].id));
+        memcpy(&wire[pos + sizeof(data[i].id)], &(data[i].value), sizeof(data[i].value));
+        memcpy(&wire[pos + sizeof(data[i].id) + sizeof(data[i].value)], &(data[i].ts), sizeof(data[i].ts));
+        pos += PROTO_V1_READING_SIZE;
+    }
+
+    return pos;
+}
+
+// Unpacks v1 readings the way connmgr does, the result is checked so the copies are not optimised away
+static void _decode_v1(size_t size)
+{
+    sensor_data_t reading;
+    long i = 0;
+    for(size_t pos = 0; pos < size; pos += PROTO_V1_READING_SIZE, i++)
+    {
+        memcpy(&(reading.id), &wire[pos], sizeof(reading.id));
+        memcpy(&(reading.value), &wire[pos + sizeof(reading.id)], sizeof(reading.value));
+        memcpy(&(reading.ts), &wire[pos + sizeof(reading.id) + sizeof(reading.value)], sizeof(reading.ts));
+        if(reading.ts != data[i].ts || reading.value != data[i].value)
+        {
+            fprintf(stderr, "v1: decoded readings do not match\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static uint64_t _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec*1000000000ull + (uint64_t) ts.tv_nsec;
+}
@@ -1,270 +1,804 @@
-/***************************************************************************************************
- *
- * FileName:        sbuffer.c
- * Comment:         Shared buffer prototypes with thread-safe implementation
- * Dependencies:    Header (.h) files sbuffer.h
- *
- *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
- * Author                       Date            Version       Comment
- *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
- * Maxim Yudayev	            22/12/2019      0.1           Template copied from Toledo
- *                              25/12/2019      1.0           Seemingly no issues when multithreading
- *                                                            When sleeping threads (to simulate)
- *                                                            waiting on IO, no data corruption occurs
- *                                                            but Valgrind still complains despite of
- *                                                            no memory leaks
- *                              07/01/2020      2.0           Final improvements to sbuffer, no Valgrind
- *                                                            erros, leaks or seg faults
- *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
- * TODO                         Date            Finished      Comment
- *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
- * 1) Make functions thread     24/12/2019      25/12/2019    Chose the read/write lock for shared
- * safe and configure                                         buffer itself and 2 mutexes for 
- * synchronization                                            implementator program
- * (free, push, pop)
- * 2) Call sbuffer_remove       25/12/2019      25/12/2019    For higher level caller this change makes
- * internally from sbuffer_pop                                no difference
- * since it is now allowed to
- * change function signatures,
- * only add new ones
- * 3) Adjust implementation for 25/12/2019      25/12/2019
- * proposed sbuffer data
- * encapsulation
- *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
- *
- ***************************************************************************************************/
-
-/**
- * Includes
- **/
-#define _GNU_SOURCE
-#define BUILDING_GATEWAY
-#include <stdlib.h>
-#include <stdio.h>
-#include <string.h>
-#include <unistd.h>
-#include <errno.h>
-#include <inttypes.h>
-#include <pthread.h>
-#include "sbuffer.h"
-#include "config.h"
-
-/**
- * Custom Types
- **/
-struct sbuffer_data {
-    sensor_data_t data;
-    int read_by[READER_THREADS]; // labeling to identify when the message was read by both threads and can be removed
-};
-
-typedef struct sbuffer_node {
-    struct sbuffer_node * next;
-    sbuffer_data_t element;
-} sbuffer_node_t;
-
-struct sbuffer {
-    sbuffer_node_t * head;
-    sbuffer_node_t * tail;
-    pthread_rwlock_t * lock;
-};
-
-/**
- * Private Prototypes
- **/
-static void _sbuffer_print_content(sbuffer_t * buffer);
-static int _is_read_by_all(sbuffer_node_t * node);
-
-/**
- * Public Prototypes
- **/
-//
-int sbuffer_init(sbuffer_t ** buffer)
-{
-    *buffer = malloc(sizeof(sbuffer_t));
-    
-    if(*buffer == NULL) return SBUFFER_FAILURE;
-    (*buffer)->head = NULL;
-    (*buffer)->tail = NULL;
-    (*buffer)->lock = malloc(sizeof(pthread_rwlock_t)); // malloc rwlock so it can be referenced from external object during cleanup
-    pthread_rwlock_init((*buffer)->lock, NULL);
-    
-    return SBUFFER_SUCCESS; 
-}
-
-int sbuffer_free(sbuffer_t ** buffer)
-{
-    pthread_rwlock_t * lock;
-    pthread_rwlock_wrlock((*buffer)->lock); // apply write lock to avoid interruption during clean up
-    
-    if((buffer == NULL) || (*buffer == NULL)) 
-    {
-        pthread_rwlock_unlock((*buffer)->lock);
-        
-        return SBUFFER_FAILURE;
-    }
-    
-    while(sbuffer_remove(*buffer, NULL) != SBUFFER_NO_DATA);
-    
-    lock = (*buffer)->lock; // copy pointer to rwlock
-    free(*buffer); // free and NULL the buffer
-    *buffer = NULL;
-    pthread_rwlock_unlock(lock); // release the rwlock to the buffer
-    pthread_rwlock_destroy(lock); // destroy the rwlock to the buffer
-    free(lock); // free the memory allocated to rwlock
-    
-    return SBUFFER_SUCCESS;		
-}
-
-int sbuffer_remove(sbuffer_t * buffer, sensor_data_t * data)
-{
-    if(buffer == NULL) return SBUFFER_FAILURE;
-    if(buffer->head == NULL) return SBUFFER_NO_DATA;
-    
-    sbuffer_node_t * dummy = buffer->head;
-
-    if(buffer->head == buffer->tail) buffer->head = buffer->tail = NULL; // buffer has only one node
-    else buffer->head = buffer->head->next; // buffer has many nodes
-    
-    dummy->next = NULL;
-
-    #if (DEBUG_LVL > 1)
-    printf("After removing, node pointing to %p points to next at %p\n", dummy, dummy->next);
-    fflush(stdout);
-    #endif
-
-    free(dummy); // release node from memory
-
-    return SBUFFER_SUCCESS;
-}
-
-int sbuffer_pop(sbuffer_t * buffer, void ** node_ptr, sensor_data_t * data, int readby)
-{
-    if(buffer == NULL) return SBUFFER_FAILURE;
-
-    sbuffer_node_t ** node = (sbuffer_node_t **) node_ptr;
-    pthread_rwlock_wrlock(buffer->lock);
-    if(buffer->head == NULL || (buffer->tail != NULL && buffer->tail->element.read_by[readby] == 1)) // if sbuffer is empty or thread already at last element and read it before
-    {
-        if(buffer->head == NULL) *node = NULL;
-        else *node = buffer->tail;
-        pthread_rwlock_unlock(buffer->lock);
-
-        return SBUFFER_NO_DATA;
-    } else if(buffer->head != NULL && *node == buffer->head && _is_read_by_all(*node)) // before poping data, check to remove current node if it was read by all
-    {
-        #if (DEBUG_LVL > 1)
-        printf("Thread %d removed node %p\n", readby, *node);
-        fflush(stdout);
-        #endif
-
-        *node = (*node)->next; // set node pointing to next element, allowed to be NULL and will trigger 3rd condition on next iteration
-        sbuffer_remove(buffer, NULL); // remove the node now that we know no one will definitely use it, applies to only 1 element in buffer, will put head to NULL and force other threads into 2nd condition
-        pthread_rwlock_unlock(buffer->lock);
-
-        return SBUFFER_NODE_ALREADY_CONSUMED;
-    } else if(buffer->head != NULL && buffer->head->element.read_by[readby] == 0) *node = buffer->head;
-    else if(*node != NULL && (*node)->element.read_by[readby] == 1 && (*node)->next != NULL) *node = (*node)->next;
-    // else we treat the node that we point to already
-    
-    #if (DEBUG_LVL > 1)
-    printf("Next node now for thread %d - %p vs head %p and tail %p\n", readby, *node, buffer->head, buffer->tail);
-    printf("Thread %d marked node %p read\n", readby, *node);
-    fflush(stdout);
-    #endif
-
-    *data = (*node)->element.data;
-    (*node)->element.read_by[readby] = 1;
-
-    if(_is_read_by_all(*node)) // if node was read by all threads, remove it from shared buffer
-    {
-        #if (DEBUG_LVL > 1)
-        printf("Thread %d removed node %p\n", readby, *node);
-        fflush(stdout);
-        #endif
-        
-        sbuffer_remove(buffer, NULL);
-        *node = NULL; // set node pointing to NULL
-    } else if((*node)->next != NULL) *node = (*node)->next;
-    
-    #if (DEBUG_LVL > 1)
-    _sbuffer_print_content(buffer);
-    #endif
-    
-    pthread_rwlock_unlock(buffer->lock);
-    
-    return SBUFFER_SUCCESS;
-}
-
-int sbuffer_insert(sbuffer_t * buffer, sensor_data_t * data)
-{
-    if(buffer == NULL) return SBUFFER_FAILURE;
-    
-    sbuffer_node_t * dummy = malloc(sizeof(sbuffer_node_t));
-    if(dummy == NULL) return SBUFFER_FAILURE;
-    
-    dummy->element.data = *data;
-    dummy->next = NULL;
-    for(int i = 0; i < READER_THREADS; i++) dummy->element.read_by[i] = 0;
-
-    pthread_rwlock_wrlock(buffer->lock);
-    if(buffer == NULL) 
-    {
-        pthread_rwlock_unlock(buffer->lock);
-        free(dummy);
-        
-        return SBUFFER_FAILURE;
-    }
-    
-    if(buffer->tail == NULL) buffer->head = buffer->tail = dummy; // buffer empty (buffer->head should also be NULL)
-    else // buffer not empty
-    {
-        buffer->tail->next = dummy;
-        buffer->tail = dummy; 
-    }
-    
-    #if (DEBUG_LVL > 1)
-    printf("\nNew node at %p and next node %p- %"PRIu16" %g %ld datamgr (%d) storagemgr (%d)\n", buffer->tail, buffer->tail->next, buffer->tail->element.data.id, buffer->tail->element.data.value, buffer->tail->element.data.ts, buffer->tail->element.read_by[0], buffer->tail->element.read_by[1]);
-    fflush(stdout);
-    _sbuffer_print_content(buffer);
-    #endif
-    
-    pthread_rwlock_unlock(buffer->lock);
-
-    return SBUFFER_SUCCESS;
-}
-
-void sbuffer_print_content(sbuffer_t * buffer)
-{
-    pthread_rwlock_rdlock(buffer->lock);
-    _sbuffer_print_content(buffer);
-    pthread_rwlock_unlock(buffer->lock);
-}
-
-static void _sbuffer_print_content(sbuffer_t * buffer)
-{
-    printf("\n##### Printing SBUFFER Content Summary #####\n");
-    sbuffer_node_t * dummy = buffer->head;
-    for(int i = 0; dummy != NULL; dummy = dummy->next, i++)
-    {
-        printf("%d: %p | %p | %"PRIu16" - %g - %ld - [%d, %d]\n", i, dummy, dummy->next, dummy->element.data.id, dummy->element.data.value, dummy->element.data.ts, dummy->element.read_by[0], dummy->element.read_by[1]);
-    }
-    printf("\n");
-    fflush(stdout);
-}
-
-static int _is_read_by_all(sbuffer_node_t * node)
-{
-    for(int i = 0; i < READER_THREADS; i++) // check if node has been utilised by all threads
-    {
-        if(node->element.read_by[i] == 0) return 0; // if the node was not read by any of the threads, indicate
-    }
-    return 1;
-}
-
-void write_to_pipe(pthread_mutex_t * pipe_mutex, int * pfds, char * send_buf)
-{
-    pthread_mutex_lock(pipe_mutex);
-    write(*(pfds+1), send_buf, strlen(send_buf)+1);
-    pthread_mutex_unlock(pipe_mutex);        
-    free(send_buf);
-}
\ No newline at end of file
+/***************************************************************************************************
+ *
+ * FileName:        sbuffer.c
+ * Comment:         Shared buffer prototypes with thread-safe implementation
+ * Dependencies:    Header (.h) files sbuffer.h
+ *
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Author                       Date            Version       Comment
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Maxim Yudayev	            22/12/2019      0.1           Template copied from Toledo
+ *                              25/12/2019      1.0           Seemingly no issues when multithreading
+ *                                                            When sleeping threads (to simulate)
+ *                                                            waiting on IO, no data corruption occurs
+ *                                                            but Valgrind still complains despite of
+ *                                                            no memory leaks
+ *                              07/01/2020      2.0           Final improvements to sbuffer, no Valgrind
+ *                                                            erros, leaks or seg faults
+ *                              16/10/2026      2.1           Linked-list engine, selectable with
+ *                                                            SBUFFER_ENGINE=list. write_to_pipe moved
+ *                                                            to sbuffer_common.c
+ *                              16/10/2026      2.2           sbuffer_pop_batch, several readings per
+ *                                                            lock acquisition
+ *                              16/10/2026      2.3           sbuffer_insert_batch, chain of nodes
+ *                                                            spliced in with one lock acquisition
+ *                              16/10/2026      2.4           sbuffer_wait/sbuffer_wakeup, idle readers
+ *                                                            park instead of spinning on the lock
+ *                              16/10/2026      2.5           Nodes come from a slab pool with per
+ *                                                            thread caches (sbuffer_pool.c)
+ *                              16/10/2026      3.0           Readers subscribe at run time and own a
+ *                                                            cursor (last consumed node) instead of
+ *                                                            read_by flags in every node. The list
+ *                                                            keeps a consumed dummy node at its head
+ *                                                            so cursors never dangle; nodes are
+ *                                                            reclaimed once the slowest live reader
+ *                                                            passed them
+ *                              16/10/2026      3.1           Bounded to SBUFFER_CAPACITY unread
+ *                                                            readings, SBUFFER_POLICY decides what
+ *                                                            happens to readings that do not fit
+ *                              16/10/2026      3.2           Spill of readings that do not fit to
+ *                                                            disk (SBUFFER_POLICY_SPILL), moved back
+ *                                                            by the readers as they make space
+ *                              16/10/2026      3.3           Per-reader lag and queueing latency
+ *                                                            histograms in sbuffer_get_stats, replace
+ *                                                            the DEBUG_LVL > 1 dumps
+ *                              16/10/2026      3.4           Reader state in cache-line aligned
+ *                                                            blocks, one per reader
+ *                              16/10/2026      3.5           Readers pop without the lock, following
+ *                                                            atomic next pointers from their cursor.
+ *                                                            Passed nodes are retired in bulk and
+ *                                                            released once every reader's announced
+ *                                                            epoch moved past them (epoch-based
+ *                                                            reclamation), the rwlock only serializes
+ *                                                            the producer, spill drains and
+ *                                                            (un)subscribing
+ *                              16/10/2026      3.6           sbuffer_reserve/sbuffer_commit, readings
+ *                                                            are staged and linked in on commit.
+ *                                                            sbuffer_peek_batch/sbuffer_release hand
+ *                                                            out the readings in their nodes, the
+ *                                                            reader stays in its epoch in between
+ *                              16/10/2026      3.7           sbuffer_depth from seq counters of the
+ *                                                            tail and the cursors, without the lock
+ *                              16/10/2026      3.8           sbuffer_remove takes the write lock
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * TODO                         Date            Finished      Comment
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * 1) Make functions thread     24/12/2019      25/12/2019    Chose the read/write lock for shared
+ * safe and configure                                         buffer itself and 2 mutexes for 
+ * synchronization                                            implementator program
+ * (free, push, pop)
+ * 2) Call sbuffer_remove       25/12/2019      25/12/2019    For higher level caller this change makes
+ * internally from sbuffer_pop                                no difference
+ * since it is now allowed to
+ * change function signatures,
+ * only add new ones
+ * 3) Adjust implementation for 25/12/2019      25/12/2019
+ * proposed sbuffer data
+ * encapsulation
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ ***************************************************************************************************/
+
+/**
+ * Includes
+ **/
+#define _GNU_SOURCE
+#define BUILDING_GATEWAY
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include "sbuffer.h"
+#include "sbuffer_common.h"
+#include "sbuffer_pool.h"
+#include "sbuffer_spill.h"
+#include "config.h"
+
+
+/**
+ * Custom Types
+ **/
+struct sbuffer_data {
+    sensor_data_t data;
+    uint64_t seq; // insertion number, tells readers apart that are ahead or behind this node
+    uint64_t enqueued; // sbuffer_clock_us at insertion
+};
+
+typedef struct sbuffer_node {
+    _Atomic(struct sbuffer_node *) next; // published with release by the lock holder, readers follow it without the lock
+    uint64_t retired; // epoch the node was retired in, written by the lock holder only
+    sbuffer_data_t element;
+} sbuffer_node_t;
+
+typedef struct {
+    _Alignas(CACHE_LINE) _Atomic(sbuffer_node_t *) cursor; // last node consumed by this reader, the next one to read is cursor->next
+    atomic_uint_fast64_t consumed; // seq of the cursor, read by sbuffer_depth without dereferencing the cursor
+    atomic_uint_fast64_t epoch; // epoch announced while traversing nodes, 0 while quiescent, scanned by _reclaim
+    atomic_int live; // slot handed out by sbuffer_subscribe
+    _Alignas(CACHE_LINE) atomic_ulong read; // counters written by the owning reader only, atomic for sbuffer_get_stats
+    atomic_ulong latency[SBUFFER_LATENCY_BUCKETS];
+    struct sbuffer_node * pending; // last node handed out by sbuffer_peek_batch, NULL once released
+} sbuffer_reader_t; // padded to whole cache lines, no false sharing between readers
+
+struct sbuffer {
+    sbuffer_node_t * head;      // dummy node, already consumed by every live reader
+    sbuffer_node_t * tail;
+    sbuffer_node_t * limbo;     // oldest retired node, nodes from here up to head wait for the readers' epochs to move on
+    pthread_rwlock_t * lock;    // serializes the producer, spill drains and (un)subscribing, readers pop without it
+    atomic_uint_fast64_t epoch; // bumped every time _reclaim retires nodes, starts at 1
+    sbuffer_pool_t * pool;      // nodes are recycled through the pool instead of malloc/free per reading
+    sbuffer_waitq_t waitq;      // readers park here while there is nothing new for them
+    sbuffer_waitq_t spaceq;     // producer parks here while the buffer is full (SBUFFER_POLICY_BLOCK)
+    sbuffer_spill_t * spill;    // readings that did not fit, newer than all readings in memory (SBUFFER_POLICY_SPILL)
+    atomic_size_t spilled;      // sbuffer_spill_size, readable without the lock
+    unsigned long dropped;
+    unsigned long blocked;
+    uint64_t next_seq;
+    atomic_uint_fast64_t published; // seq of the tail, read by sbuffer_depth without the lock
+    sbuffer_reader_t readers[SBUFFER_MAX_READERS];
+    sensor_data_t staging[SBUFFER_BATCH_SIZE]; // open reservation, nodes are not contiguous
+};
+
+/**
+ * Private Prototypes
+ **/
+static void _epoch_enter(sbuffer_t * buffer, sbuffer_reader_t * reader);
+static void _epoch_exit(sbuffer_reader_t * reader);
+static void _reclaim(sbuffer_t * buffer);
+static sbuffer_node_t * _slowest_cursor(sbuffer_t * buffer);
+static int _drop_oldest(sbuffer_t * buffer, sensor_data_t * data);
+static int _advance_cursor(sbuffer_t * buffer, int readby, sbuffer_node_t * cursor, sbuffer_node_t * last);
+static void _count_reads(sbuffer_t * buffer, int readby, unsigned long * latency, size_t count);
+static int _has_data(sbuffer_t * buffer, int readby);
+static void _set_consumed(sbuffer_reader_t * reader, uint64_t seq);
+static size_t _depth(sbuffer_t * buffer);
+#if (SBUFFER_POLICY == SBUFFER_POLICY_BLOCK)
+static void _wait_for_space(sbuffer_t * buffer);
+#elif (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+static void _try_drain_spill(sbuffer_t * buffer);
+static int _drain_spill(sbuffer_t * buffer);
+#endif
+
+/**
+ * Public Prototypes
+ **/
+//
+int sbuffer_init(sbuffer_t ** buffer)
+{
+    *buffer = aligned_alloc(CACHE_LINE, sizeof(sbuffer_t));
+
+    if(*buffer == NULL) return SBUFFER_FAILURE;
+    if(sbuffer_pool_init(&((*buffer)->pool), sizeof(sbuffer_node_t), SBUFFER_POOL_CAPACITY, SBUFFER_POOL_GROWTH) != SBUFFER_POOL_SUCCESS)
+    {
+        free(*buffer);
+        *buffer = NULL;
+
+        return SBUFFER_FAILURE;
+    }
+    (*buffer)->spill = NULL;
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    if(sbuffer_spill_init(&((*buffer)->spill)) != SBUFFER_SPILL_SUCCESS)
+    {
+        sbuffer_pool_free(&((*buffer)->pool));
+        free(*buffer);
+        *buffer = NULL;
+
+        return SBUFFER_FAILURE;
+    }
+    #endif
+    (*buffer)->head = (*buffer)->tail = (*buffer)->limbo = sbuffer_pool_alloc((*buffer)->pool); // dummy node, never handed out to readers
+    atomic_init(&((*buffer)->head->next), NULL);
+    (*buffer)->head->element.seq = 0;
+    (*buffer)->next_seq = 1;
+    atomic_init(&((*buffer)->published), 0);
+    atomic_init(&((*buffer)->epoch), 1); // 0 marks quiescent readers
+    for(int i = 0; i < SBUFFER_MAX_READERS; i++)
+    {
+        atomic_init(&((*buffer)->readers[i].cursor), NULL);
+        atomic_init(&((*buffer)->readers[i].consumed), 0);
+        atomic_init(&((*buffer)->readers[i].epoch), 0);
+        atomic_init(&((*buffer)->readers[i].live), 0);
+        atomic_init(&((*buffer)->readers[i].read), 0);
+        (*buffer)->readers[i].pending = NULL;
+        for(int j = 0; j < SBUFFER_LATENCY_BUCKETS; j++) atomic_init(&((*buffer)->readers[i].latency[j]), 0);
+    }
+    (*buffer)->lock = malloc(sizeof(pthread_rwlock_t)); // malloc rwlock so it can be referenced from external object during cleanup
+    pthread_rwlock_init((*buffer)->lock, NULL);
+    sbuffer_waitq_init(&((*buffer)->waitq));
+    sbuffer_waitq_init(&((*buffer)->spaceq));
+    atomic_init(&((*buffer)->spilled), 0);
+    (*buffer)->dropped = 0;
+    (*buffer)->blocked = 0;
+
+    return SBUFFER_SUCCESS;
+}
+
+int sbuffer_free(sbuffer_t ** buffer)
+{
+    if((buffer == NULL) || (*buffer == NULL)) return SBUFFER_FAILURE;
+
+    pthread_rwlock_t * lock;
+    pthread_rwlock_wrlock((*buffer)->lock); // apply write lock to avoid interruption during clean up
+
+    lock = (*buffer)->lock; // copy pointer to rwlock
+    sbuffer_pool_free(&((*buffer)->pool)); // releases all nodes, retired ones and the dummy included, at once
+    sbuffer_spill_free(&((*buffer)->spill));
+    free(*buffer); // free and NULL the buffer
+    *buffer = NULL;
+    pthread_rwlock_unlock(lock); // release the rwlock to the buffer
+    pthread_rwlock_destroy(lock); // destroy the rwlock to the buffer
+    free(lock); // free the memory allocated to rwlock
+
+    return SBUFFER_SUCCESS;
+}
+
+int sbuffer_subscribe(sbuffer_t * buffer, int * readby)
+{
+    if(buffer == NULL || readby == NULL) return SBUFFER_FAILURE;
+
+    pthread_rwlock_wrlock(buffer->lock);
+    for(int i = 0; i < SBUFFER_MAX_READERS; i++)
+    {
+        sbuffer_reader_t * reader = &(buffer->readers[i]);
+        if(atomic_load_explicit(&(reader->live), memory_order_relaxed)) continue;
+
+        atomic_store_explicit(&(reader->cursor), buffer->tail, memory_order_relaxed); // new readers only see readings inserted from now on
+        atomic_store_explicit(&(reader->consumed), buffer->tail->element.seq, memory_order_relaxed);
+        atomic_store_explicit(&(reader->epoch), 0, memory_order_relaxed);
+        atomic_store_explicit(&(reader->read), 0, memory_order_relaxed);
+        reader->pending = NULL;
+        for(int j = 0; j < SBUFFER_LATENCY_BUCKETS; j++) atomic_store_explicit(&(reader->latency[j]), 0, memory_order_relaxed);
+        atomic_store_explicit(&(reader->live), 1, memory_order_release);
+        *readby = i;
+        pthread_rwlock_unlock(buffer->lock);
+
+        return SBUFFER_SUCCESS;
+    }
+    pthread_rwlock_unlock(buffer->lock);
+
+    return SBUFFER_FAILURE;
+}
+
+int sbuffer_unsubscribe(sbuffer_t * buffer, int readby)
+{
+    if(buffer == NULL || readby < 0 || readby >= SBUFFER_MAX_READERS) return SBUFFER_FAILURE;
+
+    pthread_rwlock_wrlock(buffer->lock);
+    atomic_store_explicit(&(buffer->readers[readby].live), 0, memory_order_relaxed);
+    atomic_store_explicit(&(buffer->readers[readby].cursor), NULL, memory_order_relaxed);
+    atomic_store_explicit(&(buffer->readers[readby].epoch), 0, memory_order_release); // a view that was never released must not hold nodes back
+    buffer->readers[readby].pending = NULL;
+    _reclaim(buffer); // this reader may have been the one holding nodes back
+    pthread_rwlock_unlock(buffer->lock);
+    sbuffer_waitq_notify(&(buffer->spaceq));
+
+    return SBUFFER_SUCCESS;
+}
+
+int sbuffer_remove(sbuffer_t * buffer, sensor_data_t * data)
+{
+    if(buffer == NULL) return SBUFFER_FAILURE;
+
+    pthread_rwlock_wrlock(buffer->lock); // moves cursors and retires nodes like the producer does
+    int res = _drop_oldest(buffer, data);
+    if(res == SBUFFER_SUCCESS) _reclaim(buffer); // readers may still be traversing the old dummy, it is only retired here
+    pthread_rwlock_unlock(buffer->lock);
+    if(res == SBUFFER_SUCCESS) sbuffer_waitq_notify(&(buffer->spaceq));
+
+    return res;
+}
+
+int sbuffer_pop(sbuffer_t * buffer, void ** node_ptr, sensor_data_t * data, int readby)
+{
+    int res = sbuffer_pop_batch(buffer, node_ptr, data, 1, readby);
+    if(res == SBUFFER_FAILURE) return SBUFFER_FAILURE;
+
+    return (res == 1) ? SBUFFER_SUCCESS : SBUFFER_NO_DATA;
+}
+
+int sbuffer_pop_batch(sbuffer_t * buffer, void ** node_ptr, sensor_data_t * data, int max, int readby)
+{
+    if(buffer == NULL || data == NULL || readby < 0 || readby >= SBUFFER_MAX_READERS || !atomic_load_explicit(&(buffer->readers[readby].live), memory_order_relaxed)) return SBUFFER_FAILURE;
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    _try_drain_spill(buffer); // a reader that caught up pulls spilled readings in itself
+    #endif
+
+    sbuffer_reader_t * reader = &(buffer->readers[readby]);
+    unsigned long latency[SBUFFER_LATENCY_BUCKETS];
+    uint64_t now = sbuffer_clock_us(); // one clock read for the whole batch
+    sbuffer_node_t * cursor, * last;
+    int count;
+    _epoch_enter(buffer, reader); // no node reachable from here on is released before _epoch_exit
+    do {
+        cursor = last = atomic_load_explicit(&(reader->cursor), memory_order_acquire);
+        memset(latency, 0, sizeof(latency)); // counted on the side, the copies may still be discarded
+        for(count = 0; count < max; count++)
+        {
+            sbuffer_node_t * next = atomic_load_explicit(&(last->next), memory_order_acquire); // pairs with the release in sbuffer_insert_batch, node content is visible
+            if(next == NULL) break; // reader caught up with the tail
+
+            last = next;
+            data[count] = last->element.data;
+            latency[sbuffer_latency_bucket(last->element.enqueued, now)]++;
+        }
+    } while(count > 0 && !_advance_cursor(buffer, readby, cursor, last)); // the whole batch is consumed at once
+    _epoch_exit(reader);
+    *node_ptr = (count > 0) ? last : NULL; // kept for API compatibility, reader position lives in the buffer
+    if(count > 0) _count_reads(buffer, readby, latency, (size_t) count);
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    if(count > 0) _try_drain_spill(buffer); // refill the space this batch freed
+    if(count == 0 && atomic_load_explicit(&(buffer->spilled), memory_order_relaxed) > 0) return SBUFFER_PENDING; // keeps the reader from finishing before the spill is drained
+    #endif
+
+    return count;
+}
+
+int sbuffer_peek_batch(sbuffer_t * buffer, const sensor_data_t ** view, int max, int readby)
+{
+    if(buffer == NULL || view == NULL || readby < 0 || readby >= SBUFFER_MAX_READERS || !atomic_load_explicit(&(buffer->readers[readby].live), memory_order_relaxed)) return SBUFFER_FAILURE;
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    _try_drain_spill(buffer);
+    #endif
+
+    sbuffer_reader_t * reader = &(buffer->readers[readby]);
+    unsigned long latency[SBUFFER_LATENCY_BUCKETS] = {0};
+    uint64_t now = sbuffer_clock_us();
+    sbuffer_node_t * last;
+    int count = 0;
+    _epoch_enter(buffer, reader); // held until sbuffer_release, the nodes in view are not recycled before
+    last = atomic_load_explicit(&(reader->cursor), memory_order_acquire);
+    for(; count < max; count++)
+    {
+        sbuffer_node_t * next = atomic_load_explicit(&(last->next), memory_order_acquire);
+        if(next == NULL) break;
+
+        last = next;
+        view[count] = &(last->element.data);
+        latency[sbuffer_latency_bucket(last->element.enqueued, now)]++;
+    }
+
+    reader->pending = (count > 0) ? last : NULL;
+    if(count == 0)
+    {
+        _epoch_exit(reader);
+
+        #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+        if(atomic_load_explicit(&(buffer->spilled), memory_order_relaxed) > 0) return SBUFFER_PENDING;
+        #endif
+        return 0;
+    }
+    _count_reads(buffer, readby, latency, (size_t) count);
+
+    return count;
+}
+
+int sbuffer_release(sbuffer_t * buffer, int readby)
+{
+    if(buffer == NULL || readby < 0 || readby >= SBUFFER_MAX_READERS) return SBUFFER_FAILURE;
+
+    sbuffer_reader_t * reader = &(buffer->readers[readby]);
+    sbuffer_node_t * last = reader->pending;
+    if(last == NULL) return SBUFFER_SUCCESS;
+
+    sbuffer_node_t * cursor = atomic_load_explicit(&(reader->cursor), memory_order_acquire);
+    while(cursor->element.seq < last->element.seq && !_advance_cursor(buffer, readby, cursor, last)) // with drop-oldest the producer may have moved the reader on meanwhile, never back
+    {
+        cursor = atomic_load_explicit(&(reader->cursor), memory_order_acquire);
+    }
+    reader->pending = NULL;
+    _epoch_exit(reader);
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    _try_drain_spill(buffer);
+    #endif
+
+    return SBUFFER_SUCCESS;
+}
+
+int sbuffer_insert(sbuffer_t * buffer, sensor_data_t * data)
+{
+    if(buffer == NULL) return SBUFFER_FAILURE;
+
+    return sbuffer_insert_batch(buffer, data, 1);
+}
+
+int sbuffer_insert_batch(sbuffer_t * buffer, sensor_data_t * data, int count)
+{
+    if(buffer == NULL || data == NULL) return SBUFFER_FAILURE;
+    if(count <= 0) return SBUFFER_SUCCESS;
+
+    sbuffer_node_t * first = NULL, * last = NULL;
+    uint64_t now = sbuffer_clock_us();
+    for(int i = 0; i < count; i++) // build the chain outside of the critical section
+    {
+        sbuffer_node_t * dummy = sbuffer_pool_alloc(buffer->pool);
+        if(dummy == NULL)
+        {
+            while(first != NULL)
+            {
+                dummy = first;
+                first = atomic_load_explicit(&(first->next), memory_order_relaxed);
+                sbuffer_pool_release(buffer->pool, dummy);
+            }
+
+            return SBUFFER_FAILURE;
+        }
+
+        dummy->element.data = data[i];
+        dummy->element.enqueued = now;
+        atomic_store_explicit(&(dummy->next), NULL, memory_order_relaxed);
+
+        if(first == NULL) first = dummy;
+        else atomic_store_explicit(&(last->next), dummy, memory_order_relaxed);
+        last = dummy;
+    }
+
+    pthread_rwlock_wrlock(buffer->lock); // splice the chain with as few lock acquisitions as the capacity allows
+    while(first != NULL)
+    {
+        size_t free_slots = SBUFFER_CAPACITY - _depth(buffer);
+
+        #if (SBUFFER_POLICY == SBUFFER_POLICY_BLOCK)
+        if(free_slots == 0) // wait for the slowest reader outside of the critical section
+        {
+            buffer->blocked++;
+            pthread_rwlock_unlock(buffer->lock);
+            _wait_for_space(buffer);
+            pthread_rwlock_wrlock(buffer->lock);
+            continue;
+        }
+        #elif (SBUFFER_POLICY == SBUFFER_POLICY_DROP_OLDEST)
+        free_slots = (size_t) count; // everything goes in, the surplus is trimmed from the head below
+        #elif (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+        if(sbuffer_spill_size(buffer->spill) > 0) break; // keep the order, new readings queue up behind the spilled ones
+        if(free_slots == 0) break;
+        #else
+        if(free_slots == 0) break;
+        #endif
+
+        sbuffer_node_t * chunk = first;
+        for(; free_slots > 0 && first != NULL; free_slots--) // cut off as many nodes as fit
+        {
+            first->element.seq = buffer->next_seq++;
+            last = first;
+            first = atomic_load_explicit(&(first->next), memory_order_relaxed);
+        }
+        atomic_store_explicit(&(last->next), NULL, memory_order_relaxed);
+        atomic_store_explicit(&(buffer->tail->next), chunk, memory_order_release); // readers may follow the chain as of here
+        buffer->tail = last;
+        atomic_store_explicit(&(buffer->published), last->element.seq, memory_order_release);
+
+        #if (SBUFFER_POLICY == SBUFFER_POLICY_DROP_OLDEST)
+        while(_depth(buffer) > SBUFFER_CAPACITY) // the oldest reading of the whole buffer goes, not one of the inserting sensor
+        {
+            _drop_oldest(buffer, NULL);
+            buffer->dropped++;
+        }
+        #endif
+        _reclaim(buffer); // nothing to keep around if there are no live readers
+
+        if(first != NULL) sbuffer_waitq_notify(&(buffer->waitq)); // readers must see this chunk before space frees up for the rest
+    }
+    while(first != NULL) // readings that did not fit (drop-newest, spill)
+    {
+        sbuffer_node_t * dummy = first;
+        first = atomic_load_explicit(&(first->next), memory_order_relaxed);
+        #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+        if(sbuffer_spill_append(buffer->spill, &(dummy->element.data), 1) == 0) buffer->dropped++; // spill is out of segments
+        #else
+        buffer->dropped++;
+        #endif
+        sbuffer_pool_release(buffer->pool, dummy);
+    }
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    atomic_store_explicit(&(buffer->spilled), sbuffer_spill_size(buffer->spill), memory_order_relaxed);
+    #endif
+    pthread_rwlock_unlock(buffer->lock);
+    sbuffer_waitq_notify(&(buffer->waitq));
+
+    return SBUFFER_SUCCESS;
+}
+
+int sbuffer_reserve(sbuffer_t * buffer, sensor_data_t ** slots, int count)
+{
+    if(buffer == NULL || slots == NULL || count <= 0) return SBUFFER_FAILURE;
+
+    *slots = buffer->staging; // nodes come from the pool one by one, readings are linked in on commit
+
+    return (count < SBUFFER_BATCH_SIZE) ? count : SBUFFER_BATCH_SIZE;
+}
+
+int sbuffer_commit(sbuffer_t * buffer, int count)
+{
+    if(buffer == NULL || count < 0) return SBUFFER_FAILURE;
+
+    return sbuffer_insert_batch(buffer, buffer->staging, count);
+}
+
+int sbuffer_wait(sbuffer_t * buffer, int readby, int timeout_ms)
+{
+    if(buffer == NULL || readby < 0 || readby >= SBUFFER_MAX_READERS) return SBUFFER_FAILURE;
+
+    for(int i = 0; i < SBUFFER_WAIT_SPINS; i++) // data usually arrives in bursts, stay on the CPU for a moment before sleeping
+    {
+        if(_has_data(buffer, readby)) return SBUFFER_SUCCESS;
+        CPU_RELAX();
+    }
+
+    unsigned int key = sbuffer_waitq_prepare(&(buffer->waitq));
+    if(_has_data(buffer, readby))
+    {
+        sbuffer_waitq_cancel(&(buffer->waitq));
+
+        return SBUFFER_SUCCESS;
+    }
+    sbuffer_waitq_commit(&(buffer->waitq), key, timeout_ms);
+
+    return _has_data(buffer, readby) ? SBUFFER_SUCCESS : SBUFFER_NO_DATA;
+}
+
+void sbuffer_wakeup(sbuffer_t * buffer)
+{
+    if(buffer != NULL) sbuffer_waitq_notify(&(buffer->waitq));
+}
+
+size_t sbuffer_depth(sbuffer_t * buffer)
+{
+    uint64_t published = atomic_load_explicit(&(buffer->published), memory_order_acquire);
+    uint64_t slowest = published; // cursors that moved on after 'published' was loaded count as caught up
+    for(int i = 0; i < SBUFFER_MAX_READERS; i++)
+    {
+        if(!atomic_load_explicit(&(buffer->readers[i].live), memory_order_acquire)) continue;
+
+        uint64_t consumed = atomic_load_explicit(&(buffer->readers[i].consumed), memory_order_relaxed);
+        if(consumed < slowest) slowest = consumed;
+    }
+
+    return (size_t) (published - slowest);
+}
+
+void sbuffer_get_stats(sbuffer_t * buffer, sbuffer_stats_t * stats)
+{
+    pthread_rwlock_rdlock(buffer->lock); // cursors only move forward meanwhile, the nodes they point at stay allocated
+    stats->depth = _depth(buffer);
+    stats->dropped = buffer->dropped;
+    stats->blocked = buffer->blocked;
+    stats->spilled = atomic_load_explicit(&(buffer->spilled), memory_order_relaxed);
+    for(int i = 0; i < SBUFFER_MAX_READERS; i++)
+    {
+        sbuffer_reader_t * reader = &(buffer->readers[i]);
+        stats->readers[i].live = atomic_load_explicit(&(reader->live), memory_order_relaxed);
+        stats->readers[i].lag = stats->readers[i].live ? (size_t) (buffer->tail->element.seq - atomic_load_explicit(&(reader->cursor), memory_order_acquire)->element.seq) : 0;
+        stats->readers[i].read = atomic_load_explicit(&(reader->read), memory_order_relaxed);
+        for(int j = 0; j < SBUFFER_LATENCY_BUCKETS; j++) stats->readers[i].latency[j] = atomic_load_explicit(&(reader->latency[j]), memory_order_relaxed);
+    }
+    pthread_rwlock_unlock(buffer->lock);
+    stats->capacity = SBUFFER_CAPACITY;
+    stats->high_water = (size_t) SBUFFER_CAPACITY * SBUFFER_HIGH_WATER / 100;
+    stats->low_water = (size_t) SBUFFER_CAPACITY * SBUFFER_LOW_WATER / 100;
+    stats->policy = SBUFFER_POLICY;
+}
+
+void sbuffer_print_content(sbuffer_t * buffer)
+{
+    sbuffer_stats_t stats;
+    sbuffer_pool_stats_t pool_stats;
+    sbuffer_get_stats(buffer, &stats);
+    sbuffer_pool_get_stats(buffer->pool, &pool_stats);
+
+    printf("\n##### Printing SBUFFER Content Summary #####\n");
+    printf("node pool: %zu nodes in %zu slabs, %lu hits, %lu misses\n", pool_stats.capacity, pool_stats.slabs, pool_stats.hits, pool_stats.misses);
+    sbuffer_print_stats(&stats);
+}
+
+// Announces the current epoch for 'reader', nodes retired from now on are kept until _epoch_exit
+static void _epoch_enter(sbuffer_t * buffer, sbuffer_reader_t * reader)
+{
+    atomic_store_explicit(&(reader->epoch), atomic_load_explicit(&(buffer->epoch), memory_order_acquire), memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst); // announcement is visible before any cursor or node is loaded, pairs with the fence in _reclaim
+}
+
+static void _epoch_exit(sbuffer_reader_t * reader)
+{
+    atomic_store_explicit(&(reader->epoch), 0, memory_order_release);
+}
+
+// Retires the nodes every live reader moved past and releases the retired nodes no reader can still be traversing, must be called with the write lock held
+static void _reclaim(sbuffer_t * buffer)
+{
+    uint64_t slowest = _slowest_cursor(buffer)->element.seq;
+    if(buffer->head->element.seq < slowest)
+    {
+        uint64_t epoch = atomic_fetch_add_explicit(&(buffer->epoch), 1, memory_order_acq_rel); // one epoch for the whole batch, readers announcing a later one cannot reach these nodes
+        while(buffer->head->element.seq < slowest) // the node right after head becomes the new dummy
+        {
+            buffer->head->retired = epoch;
+            buffer->head = atomic_load_explicit(&(buffer->head->next), memory_order_relaxed);
+        }
+    }
+
+    atomic_thread_fence(memory_order_seq_cst); // pairs with the fence in _epoch_enter
+    uint64_t oldest = UINT64_MAX;
+    for(int i = 0; i < SBUFFER_MAX_READERS; i++)
+    {
+        uint64_t epoch = atomic_load_explicit(&(buffer->readers[i].epoch), memory_order_acquire); // pairs with the release in _epoch_exit, the reader is done with what it saw
+        if(epoch != 0 && epoch < oldest) oldest = epoch;
+    }
+
+    while(buffer->limbo != buffer->head && buffer->limbo->retired < oldest) // retired in order, stop at the first node a reader may still hold
+    {
+        sbuffer_node_t * dummy = buffer->limbo;
+        buffer->limbo = atomic_load_explicit(&(dummy->next), memory_order_relaxed);
+        sbuffer_pool_release(buffer->pool, dummy); // recycle node
+    }
+}
+
+// Cursor of the slowest live reader, the tail if there are none, must be called with the lock held
+static sbuffer_node_t * _slowest_cursor(sbuffer_t * buffer)
+{
+    sbuffer_node_t * slowest = buffer->tail;
+    for(int i = 0; i < SBUFFER_MAX_READERS; i++)
+    {
+        if(!atomic_load_explicit(&(buffer->readers[i].live), memory_order_relaxed)) continue;
+
+        sbuffer_node_t * cursor = atomic_load_explicit(&(buffer->readers[i].cursor), memory_order_acquire);
+        if(cursor->element.seq < slowest->element.seq) slowest = cursor;
+    }
+
+    return slowest;
+}
+
+// Moves every reader still at the slowest cursor past the oldest unread reading, must be called with the write lock held
+static int _drop_oldest(sbuffer_t * buffer, sensor_data_t * data)
+{
+    sbuffer_node_t * slowest = _slowest_cursor(buffer);
+    sbuffer_node_t * oldest = atomic_load_explicit(&(slowest->next), memory_order_relaxed);
+    if(oldest == NULL) return SBUFFER_NO_DATA;
+
+    if(data != NULL) *data = oldest->element.data;
+    for(int i = 0; i < SBUFFER_MAX_READERS; i++)
+    {
+        sbuffer_node_t * expected = slowest;
+        if(atomic_load_explicit(&(buffer->readers[i].live), memory_order_relaxed) && atomic_compare_exchange_strong(&(buffer->readers[i].cursor), &expected, oldest)) _set_consumed(&(buffer->readers[i]), oldest->element.seq); // a reader that moved on meanwhile keeps its own position
+    }
+
+    return SBUFFER_SUCCESS;
+}
+
+// Moves the cursor of 'readby' from 'cursor' to 'last', fails if the producer dropped readings under it meanwhile
+static int _advance_cursor(sbuffer_t * buffer, int readby, sbuffer_node_t * cursor, sbuffer_node_t * last)
+{
+    int res = 1;
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_DROP_OLDEST)
+    res = atomic_compare_exchange_strong(&(buffer->readers[readby].cursor), &cursor, last);
+    #else
+    atomic_store_explicit(&(buffer->readers[readby].cursor), last, memory_order_release); // only this reader writes its cursor
+    #endif
+
+    if(res)
+    {
+        _set_consumed(&(buffer->readers[readby]), last->element.seq);
+        sbuffer_waitq_notify(&(buffer->spaceq));
+    }
+
+    return res;
+}
+
+// Adds a popped batch to the counters of 'readby', only the reader itself writes them
+static void _count_reads(sbuffer_t * buffer, int readby, unsigned long * latency, size_t count)
+{
+    sbuffer_reader_t * reader = &(buffer->readers[readby]);
+
+    atomic_store_explicit(&(reader->read), atomic_load_explicit(&(reader->read), memory_order_relaxed) + count, memory_order_relaxed);
+    for(int i = 0; i < SBUFFER_LATENCY_BUCKETS; i++)
+    {
+        if(latency[i] > 0) atomic_store_explicit(&(reader->latency[i]), atomic_load_explicit(&(reader->latency[i]), memory_order_relaxed) + latency[i], memory_order_relaxed);
+    }
+}
+
+static int _has_data(sbuffer_t * buffer, int readby)
+{
+    sbuffer_reader_t * reader = &(buffer->readers[readby]);
+    if(!atomic_load_explicit(&(reader->live), memory_order_relaxed)) return 0;
+
+    _epoch_enter(buffer, reader);
+    int res = (atomic_load_explicit(&(atomic_load_explicit(&(reader->cursor), memory_order_acquire)->next), memory_order_acquire) != NULL);
+    _epoch_exit(reader);
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    if(!res && atomic_load_explicit(&(buffer->spilled), memory_order_relaxed) > 0) // the reader can drain the spill
+    {
+        pthread_rwlock_rdlock(buffer->lock);
+        res = (_depth(buffer) < SBUFFER_CAPACITY);
+        pthread_rwlock_unlock(buffer->lock);
+    }
+    #endif
+
+    return res;
+}
+
+// Publishes the seq of the cursor of 'reader' for sbuffer_depth. With drop-oldest the producer moves cursors as well, a store that lost the race must not move 'consumed' back
+static void _set_consumed(sbuffer_reader_t * reader, uint64_t seq)
+{
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_DROP_OLDEST)
+    uint64_t consumed = atomic_load_explicit(&(reader->consumed), memory_order_relaxed);
+    while(consumed < seq && !atomic_compare_exchange_weak_explicit(&(reader->consumed), &consumed, seq, memory_order_relaxed, memory_order_relaxed));
+    #else
+    atomic_store_explicit(&(reader->consumed), seq, memory_order_relaxed); // only this reader moves its cursor
+    #endif
+}
+
+// Number of readings the slowest live reader did not consume yet, must be called with the lock held
+static size_t _depth(sbuffer_t * buffer)
+{
+    return (size_t) (buffer->tail->element.seq - _slowest_cursor(buffer)->element.seq);
+}
+
+#if (SBUFFER_POLICY == SBUFFER_POLICY_BLOCK)
+static void _wait_for_space(sbuffer_t * buffer)
+{
+    unsigned int key = sbuffer_waitq_prepare(&(buffer->spaceq));
+
+    pthread_rwlock_rdlock(buffer->lock);
+    int full = (_depth(buffer) >= SBUFFER_CAPACITY);
+    pthread_rwlock_unlock(buffer->lock);
+
+    if(full) sbuffer_waitq_commit(&(buffer->spaceq), key, SBUFFER_WAIT_TIMEOUT);
+    else sbuffer_waitq_cancel(&(buffer->spaceq));
+}
+#endif
+
+#if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+// Drains the spill from a reader, skipped if the producer or another reader holds the lock, so readers never block
+static void _try_drain_spill(sbuffer_t * buffer)
+{
+    if(atomic_load_explicit(&(buffer->spilled), memory_order_relaxed) == 0 || pthread_rwlock_trywrlock(buffer->lock) != 0) return;
+
+    _reclaim(buffer);
+    int drained = _drain_spill(buffer);
+    pthread_rwlock_unlock(buffer->lock);
+    if(drained > 0) sbuffer_waitq_notify(&(buffer->waitq));
+}
+
+// Moves spilled readings back to the tail as far as the capacity allows, must be called with the write lock held
+static int _drain_spill(sbuffer_t * buffer)
+{
+    sensor_data_t chunk[SBUFFER_BATCH_SIZE];
+    uint64_t now = sbuffer_clock_us(); // latency is counted from here, time spent on disk is not included
+    int drained = 0;
+
+    while(sbuffer_spill_size(buffer->spill) > 0 && _depth(buffer) < SBUFFER_CAPACITY)
+    {
+        size_t free_slots = SBUFFER_CAPACITY - _depth(buffer);
+        int size = sbuffer_spill_read(buffer->spill, chunk, (free_slots < SBUFFER_BATCH_SIZE) ? (int) free_slots : SBUFFER_BATCH_SIZE);
+
+        for(int i = 0; i < size; i++)
+        {
+            sbuffer_node_t * dummy = sbuffer_pool_alloc(buffer->pool);
+            if(dummy == NULL)
+            {
+                buffer->dropped += size - i;
+                break;
+            }
+            dummy->element.data = chunk[i];
+            dummy->element.seq = buffer->next_seq++;
+            dummy->element.enqueued = now;
+            atomic_store_explicit(&(dummy->next), NULL, memory_order_relaxed);
+            atomic_store_explicit(&(buffer->tail->next), dummy, memory_order_release);
+            buffer->tail = dummy;
+        }
+        atomic_store_explicit(&(buffer->published), buffer->tail->element.seq, memory_order_release);
+        drained += size;
+    }
+    atomic_store_explicit(&(buffer->spilled), sbuffer_spill_size(buffer->spill), memory_order_relaxed);
+
+    return drained;
+}
+#endif
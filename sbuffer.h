@@ -1,57 +1,214 @@
-#ifndef _SBUFFER_H_
-#define _SBUFFER_H_
-
-#include "config.h"
-
-#define SBUFFER_FAILURE -1
-#define SBUFFER_SUCCESS 0
-#define SBUFFER_NO_DATA 1
-#define SBUFFER_NODE_ALREADY_CONSUMED 2
-#define SBUFFER_NODE_NO_LONGER_AVAILABLE 3
-
-typedef struct sbuffer sbuffer_t;
-
-/**
- * All data that can be stored in the sbuffer should be encapsulated in a
- * structure, this structure can then also hold extra info needed for your implementation
- **/
-typedef struct sbuffer_data sbuffer_data_t;
-
-/**
- * Allocates and initializes a new shared buffer
- * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured
- **/
-int sbuffer_init(sbuffer_t ** buffer);
-
-/**
- * All allocated resources are freed and cleaned up
- * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured
- **/
-int sbuffer_free(sbuffer_t ** buffer);
-
-/**
- * Removes the first data in 'buffer' (at the 'head') and returns this data as '*data'  
- * 'data' must point to allocated memory because this functions doesn't allocated memory
- * If 'buffer' is empty, the function doesn't block until new data becomes available but returns SBUFFER_NO_DATA
- * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured
- **/
-int sbuffer_remove(sbuffer_t * buffer, sensor_data_t * data);
-
-/** 
- * Inserts the data in 'data' at the end of 'buffer' (at the 'tail')
- * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured
- **/
-int sbuffer_insert(sbuffer_t * buffer, sensor_data_t * data);
-
-/**
- * Labels node as 'read' by the thread, calls internally to sbuffer_remove when node 
- * has been read by all threads
- * NOTE: data may be assumed to be valid only if function returns SBUFFER_SUCESS
- **/
-int sbuffer_pop(sbuffer_t * buffer, void ** node_ptr, sensor_data_t * data, int readby);
-
-void sbuffer_print_content(sbuffer_t * buffer);
-
-void write_to_pipe(pthread_mutex_t * pipe_mutex, int * pfds, char * send_buf);
-
+#ifndef _SBUFFER_H_
+#define _SBUFFER_H_
+
+#include "config.h"
+
+#define SBUFFER_FAILURE -1
+#define SBUFFER_SUCCESS 0
+#define SBUFFER_NO_DATA 1
+#define SBUFFER_NODE_ALREADY_CONSUMED 2
+#define SBUFFER_NODE_NO_LONGER_AVAILABLE 3
+#define SBUFFER_PENDING -2
+
+#define SBUFFER_LATENCY_BUCKETS 32
+
+/**
+ * Counters of one reader slot, part of sbuffer_stats_t
+ * Latency is the time from sbuffer_insert to the reader's sbuffer_pop, bucket 0 counts readings
+ * that waited less than 1 us, bucket i > 0 those that waited [2^(i-1), 2^i) us
+ **/
+typedef struct {
+    int live;                                           // slot is subscribed
+    size_t lag;                                         // readings inserted but not yet read by this reader
+    unsigned long read;                                 // readings read since subscribing
+    unsigned long latency[SBUFFER_LATENCY_BUCKETS];
+} sbuffer_reader_stats_t;
+
+/**
+ * Fill level, backpressure and per-reader counters of a shared buffer, see sbuffer_get_stats
+ **/
+typedef struct {
+    size_t depth;           // readings not yet consumed by the slowest live reader
+    size_t capacity;        // max. depth, see SBUFFER_CAPACITY
+    size_t high_water;      // depth at which the producer should stop accepting readings
+    size_t low_water;       // depth at which the producer may accept readings again
+    int policy;             // SBUFFER_POLICY_* applied while the buffer is full
+    unsigned long dropped;  // readings discarded by the policy
+    unsigned long blocked;  // times the producer had to wait for space
+    size_t spilled;         // readings waiting on disk to be moved back into the buffer
+    sbuffer_reader_stats_t readers[SBUFFER_MAX_READERS];
+} sbuffer_stats_t;
+
+/**
+ * Two engines implement this interface, selected at build time with SBUFFER_ENGINE (see makefile):
+ * 'list' - linked list, readers pop without locking and passed nodes are released by epoch-based
+ *          reclamation, a rwlock serializes the producer (sbuffer.c)
+ * 'ring' - lock-free single-producer/multi-consumer broadcast ring of SBUFFER_RING_SIZE readings,
+ *          sbuffer_insert waits while the slowest reader is a full ring behind (sbuffer_ring.c)
+ * Readers obtain a handle with sbuffer_subscribe, up to SBUFFER_MAX_READERS at a time
+ * Both hold at most SBUFFER_CAPACITY unread readings and apply SBUFFER_POLICY when full, with
+ * SBUFFER_POLICY_SPILL readings that do not fit are moved back in order as readers make space
+ **/
+typedef struct sbuffer sbuffer_t;
+
+/**
+ * All data that can be stored in the sbuffer should be encapsulated in a
+ * structure, this structure can then also hold extra info needed for your implementation
+ **/
+typedef struct sbuffer_data sbuffer_data_t;
+
+/**
+ * Allocates and initializes a new shared buffer
+ * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured
+ **/
+int sbuffer_init(sbuffer_t ** buffer);
+
+/**
+ * All allocated resources are freed and cleaned up
+ * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured
+ **/
+int sbuffer_free(sbuffer_t ** buffer);
+
+/**
+ * Removes the first data in 'buffer' (at the 'head') and returns this data as '*data'  
+ * 'data' must point to allocated memory because this functions doesn't allocated memory
+ * If 'buffer' is empty, the function doesn't block until new data becomes available but returns SBUFFER_NO_DATA
+ * (use sbuffer_wait to block)
+ * The list engine serializes it with the producer, the ring engine moves reader cursors the way only
+ * the producer may, there it must be called from the producer's thread
+ * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured
+ **/
+int sbuffer_remove(sbuffer_t * buffer, sensor_data_t * data);
+
+/** 
+ * Inserts the data in 'data' at the end of 'buffer' (at the 'tail')
+ * If 'buffer' is full, blocks or drops a reading depending on SBUFFER_POLICY
+ * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured
+ **/
+int sbuffer_insert(sbuffer_t * buffer, sensor_data_t * data);
+
+/**
+ * Inserts the 'count' readings of the array 'data' at the end of 'buffer' as one operation,
+ * readers see them in array order
+ * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured (nothing is inserted)
+ **/
+int sbuffer_insert_batch(sbuffer_t * buffer, sensor_data_t * data, int count);
+
+/**
+ * Reserves up to 'count' consecutive slots at the end of 'buffer' and returns them as '*slots', the
+ * producer writes readings there itself and publishes them with sbuffer_commit. Readers do not see
+ * reserved slots. The ring engine hands out the ring slots themselves, a reservation ends at the
+ * wrap-around and waits or stages like sbuffer_insert_batch while the ring is full. The list engine
+ * stages the readings and links them in nodes on commit
+ * Only one reservation may be open at a time, producers take turns as for the ring engine
+ * Returns the number of slots reserved (at least 1) or SBUFFER_FAILURE
+ **/
+int sbuffer_reserve(sbuffer_t * buffer, sensor_data_t ** slots, int count);
+
+/**
+ * Publishes the first 'count' readings of the open reservation, the rest of it is given up
+ * Readings that were staged go through SBUFFER_POLICY as in sbuffer_insert_batch
+ * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured (nothing is inserted)
+ **/
+int sbuffer_commit(sbuffer_t * buffer, int count);
+
+/**
+ * Registers a new reader and returns its handle as '*readby'. The reader sees every reading
+ * inserted after this call, readings are reclaimed once all live readers consumed them
+ * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if SBUFFER_MAX_READERS readers are subscribed
+ **/
+int sbuffer_subscribe(sbuffer_t * buffer, int * readby);
+
+/**
+ * Releases the handle 'readby', the buffer no longer keeps readings around for this reader
+ * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured
+ **/
+int sbuffer_unsubscribe(sbuffer_t * buffer, int readby);
+
+/**
+ * Copies the oldest reading not yet read by the subscribed reader 'readby' into '*data' and moves
+ * the reader past it, SBUFFER_NO_DATA if the reader caught up
+ * NOTE: data may be assumed to be valid only if function returns SBUFFER_SUCESS
+ **/
+int sbuffer_pop(sbuffer_t * buffer, void ** node_ptr, sensor_data_t * data, int readby);
+
+/**
+ * Same as sbuffer_pop, but copies up to 'max' consecutive readings not yet read by 'readby' into
+ * the array 'data' within one critical section
+ * Returns the number of readings copied (0 if there is no data for this reader) or SBUFFER_FAILURE
+ * With SBUFFER_POLICY_SPILL returns SBUFFER_PENDING instead of 0 while readings are still spilled,
+ * they reach the reader once slower readers made space for them
+ **/
+int sbuffer_pop_batch(sbuffer_t * buffer, void ** node_ptr, sensor_data_t * data, int max, int readby);
+
+/**
+ * Same as sbuffer_pop_batch without copying: stores pointers to up to 'max' consecutive readings not
+ * yet read by 'readby' in the array 'view'. The readings stay in the buffer and valid until the
+ * reader calls sbuffer_release, which must come before its next peek, pop or sbuffer_wait
+ * The readings in view count as unread until then. With SBUFFER_POLICY_DROP_OLDEST the ring engine
+ * hands out copies, its producer may overwrite the slots, and readings it drops meanwhile are gone
+ * Returns the number of readings in view, 0, SBUFFER_PENDING or SBUFFER_FAILURE as sbuffer_pop_batch
+ **/
+int sbuffer_peek_batch(sbuffer_t * buffer, const sensor_data_t ** view, int max, int readby);
+
+/**
+ * Moves 'readby' past the readings of its last sbuffer_peek_batch, their slots may be reused after
+ * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured
+ **/
+int sbuffer_release(sbuffer_t * buffer, int readby);
+
+/**
+ * Blocks the reader 'readby' until the buffer holds data it did not read yet, sbuffer_wakeup is
+ * called or 'timeout_ms' milliseconds elapse (no timeout if negative). Spins SBUFFER_WAIT_SPINS
+ * times before parking the thread
+ * Returns SBUFFER_SUCCESS if data is available, SBUFFER_NO_DATA on timeout or wake-up without data
+ * and SBUFFER_FAILURE if an error occured
+ **/
+int sbuffer_wait(sbuffer_t * buffer, int readby, int timeout_ms);
+
+/**
+ * Wakes up all readers blocked in sbuffer_wait, i.e. to let them notice the end of the buffer
+ **/
+void sbuffer_wakeup(sbuffer_t * buffer);
+
+/**
+ * Copies a snapshot of the counters of 'buffer' into '*stats', cheap enough to call periodically
+ * Counters of different readers are not sampled at the very same instant
+ **/
+void sbuffer_get_stats(sbuffer_t * buffer, sbuffer_stats_t * stats);
+
+/**
+ * Returns the number of readings the slowest live reader did not consume yet, as in sbuffer_stats_t
+ * Takes no lock and loads only sequence counters, meant for the producer's backpressure checks
+ **/
+size_t sbuffer_depth(sbuffer_t * buffer);
+
+/**
+ * Returns a printable name of the SBUFFER_POLICY_* value 'policy'
+ **/
+const char * sbuffer_policy_name(int policy);
+
+/**
+ * Returns the upper bound in microseconds of the bucket holding the 'quantile' (0 to 1) of the
+ * SBUFFER_LATENCY_BUCKETS buckets of 'latency', 0 if no readings were counted
+ **/
+unsigned long sbuffer_latency_quantile(const unsigned long * latency, double quantile);
+
+/**
+ * Prints '*stats' in human readable form to stdout
+ **/
+void sbuffer_print_stats(const sbuffer_stats_t * stats);
+
+/**
+ * Prints the statistics of 'buffer', see sbuffer_print_stats
+ **/
+void sbuffer_print_content(sbuffer_t * buffer);
+
+void write_to_pipe(pthread_mutex_t * pipe_mutex, int * pfds, char * send_buf);
+
+/**
+ * Signals the eventfd 'efd', wakes up a thread polling it
+ **/
+void write_to_event(int * efd);
+
 #endif  //_SBUFFER_H_
\ No newline at end of file
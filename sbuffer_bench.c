@@ -0,0 +1,338 @@
+/***************************************************************************************************
+ *
+ * FileName:        sbuffer_bench.c
+ * Comment:         Microbenchmark of the shared buffer on its own, no sockets, logger or database
+ *                  involved, so buffer engines and policies can be compared on the same workload
+ * Dependencies:    Header (.h) files sbuffer.h, built by 'make bench-sbuffer'
+ *
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Author                       Date            Version       Comment
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Maxim Yudayev                16/10/2026      1.0           Producers insert bursts at a set rate,
+ *                                                            readers pop until the producers are done.
+ *                                                            Handoff latency is exact (every reading
+ *                                                            is timed), allocations are counted by
+ *                                                            wrapping malloc and friends at link time
+ * Maxim Yudayev                16/10/2026      1.1           -z runs the zero-copy path, producers
+ *                                                            reserve/commit, readers peek/release
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * Usage: sbuffer_bench [-p producers] [-r readers] [-n readings per producer] [-R readings/s per
+ * producer, 0 is as fast as possible] [-b burst size] [-B reader batch size] [-z]
+ * A burst is inserted with one sbuffer_insert_batch (sbuffer_insert if the size is 1), readers pop
+ * with sbuffer_pop_batch (sbuffer_pop if the batch size is 1). Every reader sees every reading.
+ * With -z producers write a burst into sbuffer_reserve'd slots and commit it, readers look at their
+ * batch with sbuffer_peek_batch and release it, as connmgr and the readers of the gateway do.
+ *
+ ***************************************************************************************************/
+
+/**
+ * Includes
+ **/
+#define _GNU_SOURCE
+#define BUILDING_GATEWAY
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include "sbuffer.h"
+#include "config.h"
+
+#ifndef SBUFFER_BENCH_ENGINE
+#define SBUFFER_BENCH_ENGINE "list"
+#endif
+
+/**
+ * Custom Types
+ **/
+typedef struct {
+    int id;
+    pthread_t thread;
+    sensor_data_t * data;       // one burst, allocated up front so it does not count as a buffer allocation
+} bench_producer_t;
+
+typedef struct {
+    int id;
+    pthread_t thread;
+    sensor_data_t * data;       // one batch
+    uint64_t * samples;         // handoff latency of every popped reading in ns
+    size_t count;
+} bench_reader_t;
+
+/**
+ * Global Variables
+ **/
+static sbuffer_t * buffer;
+static int producers = 1, readers = 2, burst = 64, batch = SBUFFER_BATCH_SIZE, zero_copy = 0;
+static long readings = 1000000, rate = 0;
+static uint64_t start_ns;
+static atomic_int producers_left;
+static atomic_long allocations = 0;
+static atomic_int counting = 0;
+static pthread_mutex_t producer_mutex = PTHREAD_MUTEX_INITIALIZER; // one producer at a time in the ring engine or with -z
+
+/**
+ * Private Prototypes
+ **/
+static void * _producer(void * arg);
+static void _insert(sensor_data_t * data, int size, int id, long sent);
+static void _reserve(int size, int id, long sent);
+static void * _reader(void * arg);
+static uint64_t _now_ns(void);
+static int _compare(const void * a, const void * b);
+
+/**
+ * Allocation counters, linked in with -Wl,--wrap so only calls from the buffer code are counted
+ **/
+void * __real_malloc(size_t size);
+void * __real_calloc(size_t count, size_t size);
+void * __real_realloc(void * ptr, size_t size);
+void * __real_aligned_alloc(size_t alignment, size_t size);
+
+void * __wrap_malloc(size_t size)
+{
+    if(atomic_load_explicit(&counting, memory_order_relaxed)) atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_malloc(size);
+}
+
+void * __wrap_calloc(size_t count, size_t size)
+{
+    if(atomic_load_explicit(&counting, memory_order_relaxed)) atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_calloc(count, size);
+}
+
+void * __wrap_realloc(void * ptr, size_t size)
+{
+    if(atomic_load_explicit(&counting, memory_order_relaxed)) atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_realloc(ptr, size);
+}
+
+void * __wrap_aligned_alloc(size_t alignment, size_t size)
+{
+    if(atomic_load_explicit(&counting, memory_order_relaxed)) atomic_fetch_add_explicit(&allocations, 1, memory_order_relaxed);
+    return __real_aligned_alloc(alignment, size);
+}
+
+/**
+ * Functions
+ **/
+//
+int main(int argc, char *argv[])
+{
+    int opt;
+    while((opt = getopt(argc, argv, "p:r:n:R:b:B:z")) != -1)
+    {
+        switch(opt)
+        {
+            case 'p': producers = atoi(optarg); break;
+            case 'r': readers = atoi(optarg); break;
+            case 'n': readings = atol(optarg); break;
+            case 'R': rate = atol(optarg); break;
+            case 'b': burst = atoi(optarg); break;
+            case 'B': batch = atoi(optarg); break;
+            case 'z': zero_copy = 1; break;
+            default:
+                fprintf(stderr, "Usage: %s [-p producers] [-r readers] [-n readings per producer] [-R readings/s per producer] [-b burst size] [-B reader batch size] [-z]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+    if(producers < 1 || readers < 1 || readers > SBUFFER_MAX_READERS || readings < 1 || rate < 0 || burst < 1 || batch < 1 || (zero_copy && batch > SBUFFER_BATCH_SIZE))
+    {
+        fprintf(stderr, "Invalid arguments, at most %d readers and a batch of %d with -z\n", SBUFFER_MAX_READERS, SBUFFER_BATCH_SIZE);
+        return EXIT_FAILURE;
+    }
+
+    size_t total = (size_t) producers * (size_t) readings;
+    bench_producer_t * producer_state = calloc(producers, sizeof(bench_producer_t));
+    bench_reader_t * reader_state = calloc(readers, sizeof(bench_reader_t));
+    if(producer_state == NULL || reader_state == NULL || sbuffer_init(&buffer) != SBUFFER_SUCCESS)
+    {
+        fprintf(stderr, "Out of memory\n");
+        return EXIT_FAILURE;
+    }
+    for(int i = 0; i < producers; i++)
+    {
+        producer_state[i].id = i;
+        producer_state[i].data = malloc(sizeof(sensor_data_t) * burst);
+        if(producer_state[i].data == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+            return EXIT_FAILURE;
+        }
+    }
+    for(int i = 0; i < readers; i++)
+    {
+        reader_state[i].data = malloc(sizeof(sensor_data_t) * batch);
+        reader_state[i].samples = malloc(sizeof(uint64_t) * total);
+        if(reader_state[i].data == NULL || reader_state[i].samples == NULL || sbuffer_subscribe(buffer, &(reader_state[i].id)) != SBUFFER_SUCCESS)
+        {
+            fprintf(stderr, "Could not set up reader %d\n", i);
+            return EXIT_FAILURE;
+        }
+    }
+
+    atomic_store(&producers_left, producers);
+    atomic_store(&counting, 1); // buffer set up, from here on allocations are part of the workload
+    start_ns = _now_ns();
+    for(int i = 0; i < readers; i++) pthread_create(&(reader_state[i].thread), NULL, _reader, &(reader_state[i]));
+    for(int i = 0; i < producers; i++) pthread_create(&(producer_state[i].thread), NULL, _producer, &(producer_state[i]));
+    for(int i = 0; i < producers; i++) pthread_join(producer_state[i].thread, NULL);
+    for(int i = 0; i < readers; i++) pthread_join(reader_state[i].thread, NULL);
+    double elapsed = (double) (_now_ns() - start_ns) / 1e9;
+    atomic_store(&counting, 0);
+
+    sbuffer_stats_t stats;
+    sbuffer_get_stats(buffer, &stats);
+
+    size_t popped = 0;
+    for(int i = 0; i < readers; i++) popped += reader_state[i].count;
+    uint64_t * samples = malloc(sizeof(uint64_t) * (popped > 0 ? popped : 1)); // percentiles over all readers
+    size_t at = 0;
+    for(int i = 0; i < readers; i++)
+    {
+        memcpy(&(samples[at]), reader_state[i].samples, sizeof(uint64_t) * reader_state[i].count);
+        at += reader_state[i].count;
+    }
+    qsort(samples, popped, sizeof(uint64_t), _compare);
+
+    long allocs = atomic_load(&allocations);
+    printf("engine %s, %s policy, %d producer(s), %d reader(s), burst %d, reader batch %d, %s, ", SBUFFER_BENCH_ENGINE, sbuffer_policy_name(SBUFFER_POLICY), producers, readers, burst, batch, zero_copy ? "zero-copy" : "copying");
+    if(rate > 0) printf("%ld readings/s per producer\n", rate);
+    else printf("unthrottled\n");
+    printf("%zu readings inserted, %zu popped in %.3f s: %.0f inserts/s, %.0f pops/s\n", total, popped, elapsed, (double) total / elapsed, (double) popped / elapsed);
+    if(popped > 0) printf("handoff latency: p50 %" PRIu64 " ns, p99 %" PRIu64 " ns, p999 %" PRIu64 " ns, max %" PRIu64 " ns\n", samples[popped*50/100], samples[popped*99/100], samples[popped*999/1000], samples[popped-1]);
+    printf("allocations: %ld, %.6f per operation\n", allocs, (double) allocs / (double) (total + popped));
+    printf("%lu dropped, producer blocked %lu times, %zu left spilled\n", stats.dropped, stats.blocked, stats.spilled);
+
+    for(int i = 0; i < producers; i++) free(producer_state[i].data);
+    for(int i = 0; i < readers; i++)
+    {
+        free(reader_state[i].data);
+        free(reader_state[i].samples);
+    }
+    free(samples);
+    free(reader_state);
+    free(producer_state);
+    sbuffer_free(&buffer);
+
+    return EXIT_SUCCESS;
+}
+
+static void * _producer(void * arg)
+{
+    bench_producer_t * producer = (bench_producer_t *) arg;
+    sensor_data_t * data = producer->data;
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    for(long sent = 0; sent < readings; )
+    {
+        int size = (readings - sent < burst) ? (int) (readings - sent) : burst;
+        if(zero_copy) _reserve(size, producer->id, sent);
+        else _insert(data, size, producer->id, sent);
+        sent += size;
+
+        if(rate > 0) // pace bursts so the average stays at 'rate'
+        {
+            uint64_t gap = (uint64_t) size * 1000000000ull / (uint64_t) rate;
+            next.tv_nsec += (long) (gap % 1000000000ull);
+            next.tv_sec += (time_t) (gap / 1000000000ull) + next.tv_nsec / 1000000000l;
+            next.tv_nsec %= 1000000000l;
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+    }
+
+    if(atomic_fetch_sub(&producers_left, 1) == 1) sbuffer_wakeup(buffer); // last one out lets the readers finish
+
+    return NULL;
+}
+
+// Fills a burst in the producer's own array and copies it in
+static void _insert(sensor_data_t * data, int size, int id, long sent)
+{
+    uint64_t now = _now_ns() - start_ns;
+    for(int i = 0; i < size; i++) data[i] = (sensor_data_t) {.id = (sensor_id_t) id, .value = (sensor_value_t) now, .ts = (sensor_ts_t) (sent + i)}; // time since start fits a double exactly
+
+    #ifdef SBUFFER_SINGLE_PRODUCER
+    pthread_mutex_lock(&producer_mutex);
+    #endif
+    if(size == 1) sbuffer_insert(buffer, data);
+    else sbuffer_insert_batch(buffer, data, size);
+    #ifdef SBUFFER_SINGLE_PRODUCER
+    pthread_mutex_unlock(&producer_mutex);
+    #endif
+}
+
+// Writes a burst straight into reserved slots, a reservation may come back shorter than asked for
+static void _reserve(int size, int id, long sent)
+{
+    pthread_mutex_lock(&producer_mutex); // only one reservation may be open, in both engines
+    for(int done = 0; done < size; )
+    {
+        sensor_data_t * slots;
+        int count = sbuffer_reserve(buffer, &slots, size - done);
+        if(count == SBUFFER_FAILURE) break;
+        uint64_t now = _now_ns() - start_ns;
+        for(int i = 0; i < count; i++, done++) slots[i] = (sensor_data_t) {.id = (sensor_id_t) id, .value = (sensor_value_t) now, .ts = (sensor_ts_t) (sent + done)};
+        sbuffer_commit(buffer, count);
+    }
+    pthread_mutex_unlock(&producer_mutex);
+}
+
+static void * _reader(void * arg)
+{
+    bench_reader_t * reader = (bench_reader_t *) arg;
+    sensor_data_t * data = reader->data;
+    const sensor_data_t * view[SBUFFER_BATCH_SIZE];
+    void * node = NULL;
+
+    while(1)
+    {
+        int done = (atomic_load(&producers_left) == 0); // read before popping, so nothing inserted before is missed
+        int count;
+        if(zero_copy) count = sbuffer_peek_batch(buffer, view, batch, reader->id);
+        else if(batch == 1) count = (sbuffer_pop(buffer, &node, data, reader->id) == SBUFFER_SUCCESS) ? 1 : 0;
+        else count = sbuffer_pop_batch(buffer, &node, data, batch, reader->id);
+        #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+        if(batch == 1 && count == 0 && done) // sbuffer_pop does not tell spilled readings apart from an empty buffer
+        {
+            sbuffer_stats_t stats;
+            sbuffer_get_stats(buffer, &stats);
+            if(stats.spilled > 0) count = SBUFFER_PENDING;
+        }
+        #endif
+
+        if(count > 0)
+        {
+            uint64_t now = _now_ns() - start_ns;
+            if(zero_copy)
+            {
+                for(int i = 0; i < count; i++) reader->samples[reader->count++] = now - (uint64_t) view[i]->value;
+                sbuffer_release(buffer, reader->id);
+            }
+            else for(int i = 0; i < count; i++) reader->samples[reader->count++] = now - (uint64_t) data[i].value;
+        }
+        else if(count == 0 && done) break;
+        else sbuffer_wait(buffer, reader->id, SBUFFER_WAIT_TIMEOUT);
+    }
+
+    return NULL;
+}
+
+static uint64_t _now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static int _compare(const void * a, const void * b)
+{
+    uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+
+    return (x > y) - (x < y);
+}
@@ -0,0 +1,145 @@
+/***************************************************************************************************
+ *
+ * FileName:        sbuffer_common.c
+ * Comment:         Helpers shared by all shared buffer engines (sbuffer.c, sbuffer_ring.c)
+ * Dependencies:    Header (.h) files sbuffer.h
+ *
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Author                       Date            Version       Comment
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Maxim Yudayev                16/10/2026      1.0           Split out of sbuffer.c so that the IPC
+ *                                                            pipe helper is linked in regardless of
+ *                                                            the selected buffer engine
+ *                              16/10/2026      1.1           Futex based event count used by readers
+ *                                                            to park while the buffer is empty
+ *                              16/10/2026      1.2           Event count notify skips the epoch bump
+ *                                                            when nobody waits, the producer waits on
+ *                                                            one too while the buffer is full
+ *                              16/10/2026      1.3           Latency histogram helpers and printing
+ *                                                            of sbuffer_stats_t
+ *                              16/10/2026      1.4           write_to_event, control eventfd signal
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ ***************************************************************************************************/
+
+/**
+ * Includes
+ **/
+#define _GNU_SOURCE
+#define BUILDING_GATEWAY
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "sbuffer.h"
+#include "sbuffer_common.h"
+
+/**
+ * Functions
+ **/
+//
+void write_to_pipe(pthread_mutex_t * pipe_mutex, int * pfds, char * send_buf)
+{
+    pthread_mutex_lock(pipe_mutex);
+    write(*(pfds+1), send_buf, strlen(send_buf)+1);
+    pthread_mutex_unlock(pipe_mutex);
+    free(send_buf);
+}
+
+void write_to_event(int * efd)
+{
+    uint64_t one = 1;
+    write(*efd, &one, sizeof(one)); // cannot block, the counter would have to reach 2^64-1 first
+}
+
+void sbuffer_waitq_init(sbuffer_waitq_t * waitq)
+{
+    atomic_init(&(waitq->epoch), 0);
+    atomic_init(&(waitq->waiters), 0);
+}
+
+const char * sbuffer_policy_name(int policy)
+{
+    switch(policy)
+    {
+        case SBUFFER_POLICY_BLOCK: return "block";
+        case SBUFFER_POLICY_DROP_OLDEST: return "drop-oldest";
+        case SBUFFER_POLICY_DROP_NEWEST: return "drop-newest";
+        case SBUFFER_POLICY_SPILL: return "spill";
+        default: return "unknown";
+    }
+}
+
+unsigned int sbuffer_waitq_prepare(sbuffer_waitq_t * waitq)
+{
+    atomic_fetch_add(&(waitq->waiters), 1); // announce before sampling the epoch and re-checking the condition
+    atomic_thread_fence(memory_order_seq_cst); // pairs with the fence in sbuffer_waitq_notify
+    return atomic_load(&(waitq->epoch));
+}
+
+void sbuffer_waitq_commit(sbuffer_waitq_t * waitq, unsigned int key, int timeout_ms)
+{
+    struct timespec timeout = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_nsec = (timeout_ms % 1000) * 1000000L,
+    };
+
+    // returns immediately if the epoch moved on since sbuffer_waitq_prepare, hence no wake-up gets lost
+    syscall(SYS_futex, &(waitq->epoch), FUTEX_WAIT_PRIVATE, key, (timeout_ms < 0) ? NULL : &timeout, NULL, 0);
+    atomic_fetch_sub(&(waitq->waiters), 1);
+}
+
+void sbuffer_waitq_cancel(sbuffer_waitq_t * waitq)
+{
+    atomic_fetch_sub(&(waitq->waiters), 1);
+}
+
+void sbuffer_waitq_notify(sbuffer_waitq_t * waitq)
+{
+    atomic_thread_fence(memory_order_seq_cst); // either the waiter re-checks after the caller's update or it is seen here
+    if(atomic_load_explicit(&(waitq->waiters), memory_order_relaxed) == 0) return; // keeps the common case free of shared writes
+
+    atomic_fetch_add(&(waitq->epoch), 1);
+    syscall(SYS_futex, &(waitq->epoch), FUTEX_WAKE_PRIVATE, INT32_MAX, NULL, NULL, 0);
+}
+
+uint64_t sbuffer_clock_us(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now); // served from the vDSO, no system call
+    return (uint64_t) now.tv_sec * 1000000u + (uint64_t) now.tv_nsec / 1000u;
+}
+
+unsigned long sbuffer_latency_quantile(const unsigned long * latency, double quantile)
+{
+    unsigned long total = 0, sum = 0;
+    for(int i = 0; i < SBUFFER_LATENCY_BUCKETS; i++) total += latency[i];
+    if(total == 0) return 0;
+
+    unsigned long rank = (unsigned long) (quantile * (double) total);
+    if(rank == 0) rank = 1;
+    for(int i = 0; i < SBUFFER_LATENCY_BUCKETS; i++)
+    {
+        sum += latency[i];
+        if(sum >= rank) return 1ul << i;
+    }
+    return 1ul << (SBUFFER_LATENCY_BUCKETS - 1);
+}
+
+void sbuffer_print_stats(const sbuffer_stats_t * stats)
+{
+    printf("%zu of %zu readings, %s policy, %lu dropped, producer blocked %lu times, %zu spilled\n", stats->depth, stats->capacity, sbuffer_policy_name(stats->policy), stats->dropped, stats->blocked, stats->spilled);
+    for(int i = 0; i < SBUFFER_MAX_READERS; i++)
+    {
+        const sbuffer_reader_stats_t * reader = &(stats->readers[i]);
+        if(!reader->live) continue;
+
+        printf("reader %d: %zu behind, %lu read, latency p50 < %lu us, p99 < %lu us, max < %lu us\n", i, reader->lag, reader->read,
+            sbuffer_latency_quantile(reader->latency, 0.5), sbuffer_latency_quantile(reader->latency, 0.99), sbuffer_latency_quantile(reader->latency, 1.0));
+    }
+    fflush(stdout);
+}
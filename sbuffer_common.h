@@ -0,0 +1,69 @@
+#ifndef _SBUFFER_COMMON_H_
+#define _SBUFFER_COMMON_H_
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include "config.h"
+#include "sbuffer.h"
+
+/**
+ * Internal helpers shared by the shared buffer engines, not part of the sbuffer.h interface
+ **/
+
+#define CACHE_LINE 64 // alignment that keeps data written by different threads on separate cache lines
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+    #define CPU_RELAX() __asm__ __volatile__("yield")
+#else
+    #define CPU_RELAX() (void)0
+#endif
+
+/**
+ * Event count readers park on while the buffer is empty for them. The producer bumps 'epoch' after
+ * publishing data and only enters the kernel (futex wake) when somebody is actually parked
+ **/
+typedef struct {
+    atomic_uint epoch;
+    atomic_uint waiters;
+} sbuffer_waitq_t;
+
+void sbuffer_waitq_init(sbuffer_waitq_t * waitq);
+
+/**
+ * Registers the caller as a waiter and returns the key to pass to sbuffer_waitq_commit
+ * The caller must re-check its wake-up condition after this call and before committing,
+ * and call sbuffer_waitq_cancel instead of sbuffer_waitq_commit if the condition already holds
+ **/
+unsigned int sbuffer_waitq_prepare(sbuffer_waitq_t * waitq);
+
+/**
+ * Parks the caller until sbuffer_waitq_notify is called or 'timeout_ms' elapses (infinite if negative)
+ **/
+void sbuffer_waitq_commit(sbuffer_waitq_t * waitq, unsigned int key, int timeout_ms);
+
+void sbuffer_waitq_cancel(sbuffer_waitq_t * waitq);
+
+/**
+ * Wakes up all parked waiters, cheap (a fence, no shared write or syscall) when there are none
+ **/
+void sbuffer_waitq_notify(sbuffer_waitq_t * waitq);
+
+/**
+ * Microseconds on the monotonic clock, used to time how long readings wait in the buffer
+ **/
+uint64_t sbuffer_clock_us(void);
+
+/**
+ * Index of the sbuffer_reader_stats_t latency bucket of a reading inserted at 'enqueued' and read
+ * at 'now', a reading inserted after the reader sampled the clock counts as no wait at all
+ **/
+static inline int sbuffer_latency_bucket(uint64_t enqueued, uint64_t now)
+{
+    uint64_t us = (now > enqueued) ? now - enqueued : 0;
+    int bucket = (us == 0) ? 0 : 64 - __builtin_clzll(us);
+    return (bucket < SBUFFER_LATENCY_BUCKETS) ? bucket : SBUFFER_LATENCY_BUCKETS - 1;
+}
+
+#endif /* _SBUFFER_COMMON_H_ */
@@ -0,0 +1,249 @@
+/***************************************************************************************************
+ *
+ * FileName:        sbuffer_pool.c
+ * Comment:         Slab based fixed-size object pool with per-thread caches, replaces malloc/free
+ *                  of shared buffer nodes on the hot path
+ * Dependencies:    Header (.h) files sbuffer_pool.h
+ *
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Author                       Date            Version       Comment
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Maxim Yudayev                16/10/2026      1.0           Nodes are allocated by connmgr and
+ *                                                            released by whichever reader frees them,
+ *                                                            so reader caches spill half of their
+ *                                                            objects to the shared free list once
+ *                                                            full and the producer refills from it
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * A thread keeps caches for up to SBUFFER_POOL_THREAD_CACHES pools, identified by a pool id that is
+ * never reused, so a stale cache of a freed pool is never matched again. Threads using more pools
+ * than that go straight to the shared free list.
+ *
+ ***************************************************************************************************/
+
+/**
+ * Includes
+ **/
+#define _GNU_SOURCE
+#define BUILDING_GATEWAY
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "sbuffer_pool.h"
+#include "config.h"
+
+#define SBUFFER_POOL_THREAD_CACHES 4
+
+#define ALIGN_UP(x) (((x) + _Alignof(max_align_t) - 1) & ~(_Alignof(max_align_t) - 1))
+
+/**
+ * Custom Types
+ **/
+typedef struct pool_obj {
+    struct pool_obj * next; // only valid while the object is free
+} pool_obj_t;
+
+typedef struct pool_slab {
+    struct pool_slab * next;
+} pool_slab_t;
+
+typedef struct {
+    unsigned long pool_id;  // 0 if the entry is unused
+    pool_obj_t * head;
+    size_t count;
+} pool_cache_t;
+
+struct sbuffer_pool {
+    pthread_mutex_t lock;   // protects the shared free list and the slab list
+    pool_obj_t * free_list;
+    pool_slab_t * slabs;
+    size_t obj_size;
+    size_t growth;
+    size_t capacity;
+    size_t num_slabs;
+    unsigned long id;
+    atomic_ulong hits;
+    atomic_ulong misses;
+};
+
+/**
+ * Global Variables
+ **/
+static _Thread_local pool_cache_t caches[SBUFFER_POOL_THREAD_CACHES];
+static atomic_ulong next_pool_id = 1;
+
+/**
+ * Private Prototypes
+ **/
+static pool_cache_t * _get_cache(sbuffer_pool_t * pool);
+static int _grow(sbuffer_pool_t * pool, size_t count);
+
+/**
+ * Functions
+ **/
+//
+int sbuffer_pool_init(sbuffer_pool_t ** pool, size_t obj_size, size_t capacity, size_t growth)
+{
+    *pool = malloc(sizeof(sbuffer_pool_t));
+    if(*pool == NULL) return SBUFFER_POOL_FAILURE;
+
+    pthread_mutex_init(&((*pool)->lock), NULL);
+    (*pool)->free_list = NULL;
+    (*pool)->slabs = NULL;
+    (*pool)->obj_size = ALIGN_UP((obj_size < sizeof(pool_obj_t)) ? sizeof(pool_obj_t) : obj_size);
+    (*pool)->growth = (growth > 0) ? growth : 1;
+    (*pool)->capacity = 0;
+    (*pool)->num_slabs = 0;
+    (*pool)->id = atomic_fetch_add(&next_pool_id, 1);
+    atomic_init(&((*pool)->hits), 0);
+    atomic_init(&((*pool)->misses), 0);
+
+    if(capacity > 0 && _grow(*pool, capacity) != SBUFFER_POOL_SUCCESS)
+    {
+        sbuffer_pool_free(pool);
+
+        return SBUFFER_POOL_FAILURE;
+    }
+
+    return SBUFFER_POOL_SUCCESS;
+}
+
+void sbuffer_pool_free(sbuffer_pool_t ** pool)
+{
+    if(pool == NULL || *pool == NULL) return;
+
+    for(int i = 0; i < SBUFFER_POOL_THREAD_CACHES; i++) // forget the cache of the calling thread, other threads' caches are never matched again
+    {
+        if(caches[i].pool_id == (*pool)->id) caches[i] = (pool_cache_t) {0};
+    }
+
+    while((*pool)->slabs != NULL)
+    {
+        pool_slab_t * slab = (*pool)->slabs;
+        (*pool)->slabs = slab->next;
+        free(slab);
+    }
+    pthread_mutex_destroy(&((*pool)->lock));
+    free(*pool);
+    *pool = NULL;
+}
+
+void * sbuffer_pool_alloc(sbuffer_pool_t * pool)
+{
+    pool_cache_t * cache = _get_cache(pool);
+    pool_obj_t * obj;
+
+    if(cache != NULL && cache->head != NULL) // fast path, no shared state touched
+    {
+        obj = cache->head;
+        cache->head = obj->next;
+        cache->count--;
+        atomic_fetch_add_explicit(&(pool->hits), 1, memory_order_relaxed);
+
+        return obj;
+    }
+
+    pthread_mutex_lock(&(pool->lock));
+    if(pool->free_list == NULL)
+    {
+        if(_grow(pool, pool->growth) != SBUFFER_POOL_SUCCESS)
+        {
+            pthread_mutex_unlock(&(pool->lock));
+
+            return NULL;
+        }
+        atomic_fetch_add_explicit(&(pool->misses), 1, memory_order_relaxed);
+    } else atomic_fetch_add_explicit(&(pool->hits), 1, memory_order_relaxed);
+
+    obj = pool->free_list;
+    pool->free_list = obj->next;
+    for(int i = 0; cache != NULL && pool->free_list != NULL && i < SBUFFER_POOL_CACHE_SIZE/2; i++) // refill the thread cache while holding the lock anyway
+    {
+        pool_obj_t * cached = pool->free_list;
+        pool->free_list = cached->next;
+        cached->next = cache->head;
+        cache->head = cached;
+        cache->count++;
+    }
+    pthread_mutex_unlock(&(pool->lock));
+
+    return obj;
+}
+
+void sbuffer_pool_release(sbuffer_pool_t * pool, void * obj)
+{
+    if(obj == NULL) return;
+
+    pool_cache_t * cache = _get_cache(pool);
+    pool_obj_t * released = (pool_obj_t *) obj;
+
+    if(cache == NULL)
+    {
+        pthread_mutex_lock(&(pool->lock));
+        released->next = pool->free_list;
+        pool->free_list = released;
+        pthread_mutex_unlock(&(pool->lock));
+
+        return;
+    }
+
+    released->next = cache->head;
+    cache->head = released;
+    if(++(cache->count) < SBUFFER_POOL_CACHE_SIZE) return;
+
+    pthread_mutex_lock(&(pool->lock)); // cache is full, hand half of it over to the threads that allocate
+    while(cache->count > SBUFFER_POOL_CACHE_SIZE/2)
+    {
+        released = cache->head;
+        cache->head = released->next;
+        cache->count--;
+        released->next = pool->free_list;
+        pool->free_list = released;
+    }
+    pthread_mutex_unlock(&(pool->lock));
+}
+
+void sbuffer_pool_get_stats(sbuffer_pool_t * pool, sbuffer_pool_stats_t * stats)
+{
+    pthread_mutex_lock(&(pool->lock));
+    stats->capacity = pool->capacity;
+    stats->slabs = pool->num_slabs;
+    pthread_mutex_unlock(&(pool->lock));
+    stats->hits = atomic_load_explicit(&(pool->hits), memory_order_relaxed);
+    stats->misses = atomic_load_explicit(&(pool->misses), memory_order_relaxed);
+}
+
+static pool_cache_t * _get_cache(sbuffer_pool_t * pool)
+{
+    pool_cache_t * unused = NULL;
+    for(int i = 0; i < SBUFFER_POOL_THREAD_CACHES; i++)
+    {
+        if(caches[i].pool_id == pool->id) return &(caches[i]);
+        if(unused == NULL && caches[i].pool_id == 0) unused = &(caches[i]);
+    }
+    if(unused != NULL) unused->pool_id = pool->id; // first use of this pool by the calling thread
+
+    return unused;
+}
+
+// Must be called with the pool lock held (or before the pool is shared)
+static int _grow(sbuffer_pool_t * pool, size_t count)
+{
+    size_t header = ALIGN_UP(sizeof(pool_slab_t));
+    pool_slab_t * slab = malloc(header + count*pool->obj_size);
+    if(slab == NULL) return SBUFFER_POOL_FAILURE;
+
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    for(size_t i = count; i > 0; i--) // link objects in address order so they are handed out sequentially
+    {
+        pool_obj_t * obj = (pool_obj_t *) ((char *) slab + header + (i-1)*pool->obj_size);
+        obj->next = pool->free_list;
+        pool->free_list = obj;
+    }
+    pool->capacity += count;
+    pool->num_slabs++;
+
+    return SBUFFER_POOL_SUCCESS;
+}
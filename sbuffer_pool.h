@@ -0,0 +1,48 @@
+#ifndef _SBUFFER_POOL_H_
+#define _SBUFFER_POOL_H_
+
+#include <stddef.h>
+
+#define SBUFFER_POOL_FAILURE -1
+#define SBUFFER_POOL_SUCCESS 0
+
+/**
+ * Fixed-size object pool backing the nodes of the linked-list shared buffer engine
+ * Objects are carved out of slabs that are only returned to the system when the pool is freed.
+ * Every thread keeps a small cache of free objects (SBUFFER_POOL_CACHE_SIZE), the pool keeps a
+ * shared free list the caches refill from and spill to
+ **/
+typedef struct sbuffer_pool sbuffer_pool_t;
+
+typedef struct {
+    unsigned long hits;     // allocations served from a thread cache or the shared free list
+    unsigned long misses;   // allocations that had to grow the pool by a new slab
+    size_t capacity;        // total number of objects the pool owns
+    size_t slabs;           // number of slabs allocated
+} sbuffer_pool_stats_t;
+
+/**
+ * Allocates a pool of objects of 'obj_size' bytes with 'capacity' objects preallocated, growing
+ * by 'growth' objects whenever the free lists run dry
+ * Returns SBUFFER_POOL_SUCCESS on success and SBUFFER_POOL_FAILURE if an error occured
+ **/
+int sbuffer_pool_init(sbuffer_pool_t ** pool, size_t obj_size, size_t capacity, size_t growth);
+
+/**
+ * Releases all slabs, objects still in use become invalid
+ **/
+void sbuffer_pool_free(sbuffer_pool_t ** pool);
+
+/**
+ * Returns a free object or NULL if the pool could not grow
+ **/
+void * sbuffer_pool_alloc(sbuffer_pool_t * pool);
+
+/**
+ * Gives 'obj' back to the pool, may be called from another thread than the one that allocated it
+ **/
+void sbuffer_pool_release(sbuffer_pool_t * pool, void * obj);
+
+void sbuffer_pool_get_stats(sbuffer_pool_t * pool, sbuffer_pool_stats_t * stats);
+
+#endif /* _SBUFFER_POOL_H_ */
@@ -0,0 +1,740 @@
+/***************************************************************************************************
+ *
+ * FileName:        sbuffer_ring.c
+ * Comment:         Shared buffer engine built as a bounded single-producer/multi-consumer broadcast
+ *                  ring. Every reader owns a cursor into the ring, the producer owns the head, so
+ *                  neither inserting nor popping takes a lock
+ * Dependencies:    Header (.h) files sbuffer.h
+ *
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Author                       Date            Version       Comment
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Maxim Yudayev                16/10/2026      1.0           Drop-in replacement of the linked-list
+ *                                                            engine, same sbuffer.h contract
+ *                              16/10/2026      1.1           sbuffer_pop_batch
+ *                              16/10/2026      1.2           sbuffer_insert_batch
+ *                              16/10/2026      1.3           sbuffer_wait/sbuffer_wakeup
+ *                              16/10/2026      1.4           Readers subscribe at run time, only live
+ *                                                            readers hold the producer back
+ *                              16/10/2026      1.5           Bounded to SBUFFER_CAPACITY readings,
+ *                                                            SBUFFER_POLICY decides what happens to
+ *                                                            readings that do not fit
+ *                              16/10/2026      1.6           Spill of readings that do not fit to
+ *                                                            disk (SBUFFER_POLICY_SPILL)
+ *                              16/10/2026      1.7           Per-reader lag and queueing latency
+ *                                                            histograms in sbuffer_get_stats
+ *                              16/10/2026      1.8           Reader state in cache-line aligned
+ *                                                            blocks, one per reader
+ *                              16/10/2026      1.9           Readings and insertion times in separate
+ *                                                            arrays. sbuffer_reserve/sbuffer_commit
+ *                                                            let the producer write into the ring,
+ *                                                            sbuffer_peek_batch/sbuffer_release let
+ *                                                            readers use the slots without copying
+ *                              16/10/2026      2.0           sbuffer_depth, the head and the cursors
+ *                                                            only. sbuffer_remove is producer only
+ *                              16/10/2026      2.1           A slot being subscribed is invisible to
+ *                                                            the producer until its cursor is set
+ *                              16/10/2026      2.2           With SBUFFER_POLICY_DROP_OLDEST a peek
+ *                                                            leaves the cursor in place until
+ *                                                            sbuffer_release, as with the other policies
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * Sequence numbers ('head' and the reader cursors) grow monotonically and are only masked when
+ * indexing the ring, hence 'head - cursor' is always the number of readings a reader still has to
+ * consume, even after wrap-around. A slot may be overwritten once every reader moved past it.
+ * With SBUFFER_POLICY_DROP_OLDEST the producer moves lagging readers forward itself, so readers
+ * advance their cursor with a compare-and-swap and discard what they copied if it moved under them.
+ * A peek copies the slots aside for the same reason, but leaves the cursor where it is, the readings
+ * stay unread until sbuffer_release unless the producer drops them meanwhile.
+ * With SBUFFER_POLICY_SPILL the producer appends to the spill instead of the ring for as long as the
+ * spill is not empty, and readers move spilled readings into the ring as they make space. Whoever
+ * holds 'spill_lock' while 'spilling' is set acts as the single producer of the ring.
+ * A reservation covers free slots right after the head and is published by moving the head. When
+ * there are none (drop-newest, spill) it is staged and goes through sbuffer_insert_batch on commit.
+ *
+ ***************************************************************************************************/
+
+/**
+ * Includes
+ **/
+#define _GNU_SOURCE
+#define BUILDING_GATEWAY
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <inttypes.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "sbuffer.h"
+#include "sbuffer_common.h"
+#include "sbuffer_spill.h"
+#include "config.h"
+
+#if (SBUFFER_RING_SIZE & (SBUFFER_RING_SIZE - 1)) != 0
+    #error SBUFFER_RING_SIZE must be a power of 2
+#endif
+
+#define READER_FREE 0
+#define READER_LIVE 1
+#define READER_CLAIMED 2 // taken by sbuffer_subscribe, cursor not set yet, skipped by the producer
+
+#define RING_CAPACITY ((SBUFFER_CAPACITY < SBUFFER_RING_SIZE) ? (size_t) SBUFFER_CAPACITY : (size_t) SBUFFER_RING_SIZE)
+
+/**
+ * Custom Types
+ **/
+typedef struct {
+    _Alignas(CACHE_LINE) atomic_size_t cursor;       // sequence number of the next slot to be read, scanned by the producer
+    atomic_int live;                                 // READER_LIVE once handed out by sbuffer_subscribe
+    _Alignas(CACHE_LINE) atomic_ulong read;          // counters written by the owning reader only, atomic for sbuffer_get_stats
+    atomic_ulong latency[SBUFFER_LATENCY_BUCKETS];
+    size_t pending;                                  // readings handed out by sbuffer_peek_batch, not released yet
+    size_t peeked;                                   // cursor the pending readings start at
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_DROP_OLDEST)
+    sensor_data_t copies[SBUFFER_BATCH_SIZE];        // what sbuffer_peek_batch hands out, the producer may overwrite the slots
+    #endif
+} sbuffer_reader_t;                                  // padded to whole cache lines, no false sharing between readers or with the producer's head
+
+struct sbuffer {
+    _Alignas(CACHE_LINE) atomic_size_t head;         // sequence number of the next slot to be written, owned by the producer
+    sbuffer_waitq_t waitq;                           // readers park here while they caught up with the head
+    sbuffer_waitq_t spaceq;                          // producer parks here while the ring is full (SBUFFER_POLICY_BLOCK)
+    atomic_ulong dropped;                            // written by the producer only, atomic for sbuffer_get_stats
+    atomic_ulong blocked;
+    atomic_int spilling;                             // set while readings are waiting in the spill (SBUFFER_POLICY_SPILL)
+    atomic_size_t spilled;
+    pthread_mutex_t spill_lock;                      // serializes spill appends and drains
+    sbuffer_spill_t * spill;
+    sbuffer_reader_t readers[SBUFFER_MAX_READERS];
+    _Alignas(CACHE_LINE) int staged;                 // open reservation is in 'staging', written by the producer only
+    sensor_data_t staging[SBUFFER_BATCH_SIZE];       // reservations while the ring is full, inserted on commit
+    _Alignas(CACHE_LINE) sensor_data_t * ring;       // readings and their insertion time apart, a reservation is a plain array
+    uint64_t * enqueued;                             // sbuffer_clock_us at insertion
+    size_t mask;
+};
+
+/**
+ * Private Prototypes
+ **/
+static size_t _slowest_cursor(sbuffer_t * buffer);
+static int _has_data(sbuffer_t * buffer, int readby);
+static int _advance_cursor(sbuffer_t * buffer, int readby, size_t cursor, size_t count);
+static void _drop_oldest(sbuffer_t * buffer);
+static void _count_reads(sbuffer_t * buffer, int readby, unsigned long * latency, size_t count);
+#if (SBUFFER_POLICY == SBUFFER_POLICY_BLOCK)
+static void _wait_for_space(sbuffer_t * buffer);
+#elif (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+static void _spill(sbuffer_t * buffer, sensor_data_t * data, size_t count);
+static void _drain_spill(sbuffer_t * buffer);
+#endif
+
+/**
+ * Public Prototypes
+ **/
+//
+int sbuffer_init(sbuffer_t ** buffer)
+{
+    *buffer = aligned_alloc(CACHE_LINE, sizeof(sbuffer_t));
+    if(*buffer == NULL) return SBUFFER_FAILURE;
+
+    (*buffer)->ring = malloc(sizeof(sensor_data_t)*SBUFFER_RING_SIZE);
+    (*buffer)->enqueued = malloc(sizeof(uint64_t)*SBUFFER_RING_SIZE);
+    if((*buffer)->ring == NULL || (*buffer)->enqueued == NULL)
+    {
+        free((*buffer)->ring);
+        free((*buffer)->enqueued);
+        free(*buffer);
+        *buffer = NULL;
+
+        return SBUFFER_FAILURE;
+    }
+    (*buffer)->spill = NULL;
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    if(sbuffer_spill_init(&((*buffer)->spill)) != SBUFFER_SPILL_SUCCESS)
+    {
+        free((*buffer)->ring);
+        free((*buffer)->enqueued);
+        free(*buffer);
+        *buffer = NULL;
+
+        return SBUFFER_FAILURE;
+    }
+    #endif
+    pthread_mutex_init(&((*buffer)->spill_lock), NULL);
+    atomic_init(&((*buffer)->spilling), 0);
+    atomic_init(&((*buffer)->spilled), 0);
+    (*buffer)->mask = SBUFFER_RING_SIZE - 1;
+    (*buffer)->staged = 0;
+    atomic_init(&((*buffer)->head), 0);
+    sbuffer_waitq_init(&((*buffer)->waitq));
+    sbuffer_waitq_init(&((*buffer)->spaceq));
+    atomic_init(&((*buffer)->dropped), 0);
+    atomic_init(&((*buffer)->blocked), 0);
+    for(int i = 0; i < SBUFFER_MAX_READERS; i++)
+    {
+        atomic_init(&((*buffer)->readers[i].cursor), 0);
+        atomic_init(&((*buffer)->readers[i].live), READER_FREE);
+        atomic_init(&((*buffer)->readers[i].read), 0);
+        (*buffer)->readers[i].pending = 0;
+        for(int j = 0; j < SBUFFER_LATENCY_BUCKETS; j++) atomic_init(&((*buffer)->readers[i].latency[j]), 0);
+    }
+
+    return SBUFFER_SUCCESS;
+}
+
+int sbuffer_free(sbuffer_t ** buffer)
+{
+    if((buffer == NULL) || (*buffer == NULL)) return SBUFFER_FAILURE;
+
+    sbuffer_spill_free(&((*buffer)->spill));
+    pthread_mutex_destroy(&((*buffer)->spill_lock));
+    free((*buffer)->ring);
+    free((*buffer)->enqueued);
+    free(*buffer);
+    *buffer = NULL;
+
+    return SBUFFER_SUCCESS;
+}
+
+int sbuffer_subscribe(sbuffer_t * buffer, int * readby)
+{
+    if(buffer == NULL || readby == NULL) return SBUFFER_FAILURE;
+
+    for(int i = 0; i < SBUFFER_MAX_READERS; i++)
+    {
+        int expected = READER_FREE;
+        if(!atomic_compare_exchange_strong(&(buffer->readers[i].live), &expected, READER_CLAIMED)) continue;
+
+        // the cursor a previous reader left in this slot may lag the head by more than the ring, the producer only sees the slot once it is reset
+        atomic_store(&(buffer->readers[i].cursor), atomic_load(&(buffer->head)));
+        atomic_store_explicit(&(buffer->readers[i].read), 0, memory_order_relaxed);
+        buffer->readers[i].pending = 0;
+        for(int j = 0; j < SBUFFER_LATENCY_BUCKETS; j++) atomic_store_explicit(&(buffer->readers[i].latency[j]), 0, memory_order_relaxed);
+        atomic_store_explicit(&(buffer->readers[i].live), READER_LIVE, memory_order_release);
+        *readby = i;
+
+        return SBUFFER_SUCCESS;
+    }
+
+    return SBUFFER_FAILURE;
+}
+
+int sbuffer_unsubscribe(sbuffer_t * buffer, int readby)
+{
+    if(buffer == NULL || readby < 0 || readby >= SBUFFER_MAX_READERS) return SBUFFER_FAILURE;
+
+    atomic_store(&(buffer->readers[readby].live), READER_FREE); // the producer no longer waits for this reader
+    sbuffer_waitq_notify(&(buffer->spaceq));
+
+    return SBUFFER_SUCCESS;
+}
+
+// Producer only: moves cursors like the producer's drop-oldest, which nothing else may do at the same time
+int sbuffer_remove(sbuffer_t * buffer, sensor_data_t * data)
+{
+    if(buffer == NULL) return SBUFFER_FAILURE;
+
+    size_t head = atomic_load_explicit(&(buffer->head), memory_order_acquire);
+    size_t oldest = _slowest_cursor(buffer);
+    if(oldest == head) return SBUFFER_NO_DATA;
+
+    if(data != NULL) *data = buffer->ring[oldest & buffer->mask];
+    _drop_oldest(buffer);
+
+    return SBUFFER_SUCCESS;
+}
+
+int sbuffer_pop(sbuffer_t * buffer, void ** node_ptr, sensor_data_t * data, int readby)
+{
+    if(buffer == NULL || readby < 0 || readby >= SBUFFER_MAX_READERS || atomic_load_explicit(&(buffer->readers[readby].live), memory_order_relaxed) != READER_LIVE) return SBUFFER_FAILURE;
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    _drain_spill(buffer); // a reader that caught up pulls spilled readings in itself
+    #endif
+
+    unsigned long latency[SBUFFER_LATENCY_BUCKETS];
+    uint64_t now = sbuffer_clock_us();
+    size_t cursor, head;
+    do {
+        cursor = atomic_load_explicit(&(buffer->readers[readby].cursor), memory_order_acquire);
+        head = atomic_load_explicit(&(buffer->head), memory_order_acquire); // pairs with the release in sbuffer_insert_batch, slot content is visible
+
+        if(cursor == head)
+        {
+            *node_ptr = NULL;
+
+            return SBUFFER_NO_DATA;
+        }
+
+        *node_ptr = &(buffer->ring[cursor & buffer->mask]); // kept for API compatibility, reader position lives in the buffer
+        *data = buffer->ring[cursor & buffer->mask];
+        memset(latency, 0, sizeof(latency));
+        latency[sbuffer_latency_bucket(buffer->enqueued[cursor & buffer->mask], now)]++;
+    } while(!_advance_cursor(buffer, readby, cursor, 1)); // hand the slot back to the producer
+    _count_reads(buffer, readby, latency, 1);
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    _drain_spill(buffer);
+    #endif
+
+    return SBUFFER_SUCCESS;
+}
+
+int sbuffer_pop_batch(sbuffer_t * buffer, void ** node_ptr, sensor_data_t * data, int max, int readby)
+{
+    if(buffer == NULL || data == NULL || readby < 0 || readby >= SBUFFER_MAX_READERS || atomic_load_explicit(&(buffer->readers[readby].live), memory_order_relaxed) != READER_LIVE) return SBUFFER_FAILURE;
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    _drain_spill(buffer);
+    #endif
+
+    unsigned long latency[SBUFFER_LATENCY_BUCKETS];
+    uint64_t now = sbuffer_clock_us(); // one clock read for the whole batch
+    size_t cursor, head, count;
+    do {
+        cursor = atomic_load_explicit(&(buffer->readers[readby].cursor), memory_order_acquire);
+        head = atomic_load_explicit(&(buffer->head), memory_order_acquire);
+        count = head - cursor;
+
+        if(count == 0 || max <= 0)
+        {
+            *node_ptr = NULL;
+
+            #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+            if(atomic_load_explicit(&(buffer->spilling), memory_order_acquire)) return SBUFFER_PENDING; // keeps the reader from finishing before the spill is drained
+            #endif
+            return 0;
+        }
+        if(count > (size_t) max) count = (size_t) max;
+
+        memset(latency, 0, sizeof(latency)); // counted on the side, the copies may still be discarded
+        for(size_t i = 0; i < count; i++)
+        {
+            data[i] = buffer->ring[(cursor+i) & buffer->mask];
+            latency[sbuffer_latency_bucket(buffer->enqueued[(cursor+i) & buffer->mask], now)]++;
+        }
+        *node_ptr = &(buffer->ring[(cursor+count-1) & buffer->mask]);
+    } while(!_advance_cursor(buffer, readby, cursor, count)); // release the whole batch of slots at once
+    _count_reads(buffer, readby, latency, count);
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    _drain_spill(buffer); // refill the space this batch freed
+    #endif
+
+    return (int) count;
+}
+
+int sbuffer_peek_batch(sbuffer_t * buffer, const sensor_data_t ** view, int max, int readby)
+{
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_DROP_OLDEST)
+    if(buffer == NULL || view == NULL || readby < 0 || readby >= SBUFFER_MAX_READERS) return SBUFFER_FAILURE;
+
+    if(buffer == NULL || view == NULL || readby < 0 || readby >= SBUFFER_MAX_READERS || atomic_load_explicit(&(buffer->readers[readby].live), memory_order_relaxed) != READER_LIVE) return SBUFFER_FAILURE;
+
+    sbuffer_reader_t * reader = &(buffer->readers[readby]);
+    unsigned long latency[SBUFFER_LATENCY_BUCKETS];
+    uint64_t now = sbuffer_clock_us();
+    size_t cursor, count;
+
+    reader->pending = 0;
+    do {
+        cursor = atomic_load_explicit(&(reader->cursor), memory_order_acquire);
+        count = atomic_load_explicit(&(buffer->head), memory_order_acquire) - cursor;
+        if(count == 0 || max <= 0) return 0;
+        if(count > (size_t) max) count = (size_t) max;
+        if(count > SBUFFER_BATCH_SIZE) count = SBUFFER_BATCH_SIZE;
+
+        memset(latency, 0, sizeof(latency));
+        for(size_t i = 0; i < count; i++) // slots of lagging readers are overwritten, a view would tear
+        {
+            reader->copies[i] = buffer->ring[(cursor+i) & buffer->mask];
+            latency[sbuffer_latency_bucket(buffer->enqueued[(cursor+i) & buffer->mask], now)]++;
+        }
+        atomic_thread_fence(memory_order_acquire); // copies are read before the cursor is checked again
+    } while(atomic_load_explicit(&(reader->cursor), memory_order_relaxed) != cursor); // the producer dropped readings under the copies, they may be torn
+    for(size_t i = 0; i < count; i++) view[i] = &(reader->copies[i]);
+    reader->peeked = cursor;
+    reader->pending = count; // the cursor stays, a reader that does not release gets the same readings again
+    _count_reads(buffer, readby, latency, count);
+
+    return (int) count;
+    #else
+    if(buffer == NULL || view == NULL || readby < 0 || readby >= SBUFFER_MAX_READERS || atomic_load_explicit(&(buffer->readers[readby].live), memory_order_relaxed) != READER_LIVE) return SBUFFER_FAILURE;
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    _drain_spill(buffer);
+    #endif
+
+    sbuffer_reader_t * reader = &(buffer->readers[readby]);
+    unsigned long latency[SBUFFER_LATENCY_BUCKETS] = {0};
+    uint64_t now = sbuffer_clock_us();
+    size_t cursor = atomic_load_explicit(&(reader->cursor), memory_order_relaxed); // only this reader moves its cursor
+    size_t count = atomic_load_explicit(&(buffer->head), memory_order_acquire) - cursor; // pairs with the release in sbuffer_commit, slot content is visible
+
+    reader->pending = 0;
+    if(count == 0 || max <= 0)
+    {
+        #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+        if(atomic_load_explicit(&(buffer->spilling), memory_order_acquire)) return SBUFFER_PENDING;
+        #endif
+        return 0;
+    }
+    if(count > (size_t) max) count = (size_t) max;
+
+    for(size_t i = 0; i < count; i++) // slots stay put until the cursor moves past them in sbuffer_release
+    {
+        view[i] = &(buffer->ring[(cursor+i) & buffer->mask]);
+        latency[sbuffer_latency_bucket(buffer->enqueued[(cursor+i) & buffer->mask], now)]++;
+    }
+    reader->peeked = cursor;
+    reader->pending = count;
+    _count_reads(buffer, readby, latency, count);
+
+    return (int) count;
+    #endif
+}
+
+int sbuffer_release(sbuffer_t * buffer, int readby)
+{
+    if(buffer == NULL || readby < 0 || readby >= SBUFFER_MAX_READERS) return SBUFFER_FAILURE;
+
+    sbuffer_reader_t * reader = &(buffer->readers[readby]);
+    if(reader->pending == 0) return SBUFFER_SUCCESS;
+
+    size_t cursor = atomic_load_explicit(&(reader->cursor), memory_order_acquire);
+    while(cursor - reader->peeked < reader->pending && !_advance_cursor(buffer, readby, cursor, reader->peeked + reader->pending - cursor)) // with drop-oldest the producer may have moved the reader on meanwhile, never back
+    {
+        cursor = atomic_load_explicit(&(reader->cursor), memory_order_acquire);
+    }
+    reader->pending = 0;
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    _drain_spill(buffer); // refill the space the view freed
+    #endif
+
+    return SBUFFER_SUCCESS;
+}
+
+int sbuffer_insert(sbuffer_t * buffer, sensor_data_t * data)
+{
+    if(buffer == NULL) return SBUFFER_FAILURE;
+
+    return sbuffer_insert_batch(buffer, data, 1);
+}
+
+int sbuffer_insert_batch(sbuffer_t * buffer, sensor_data_t * data, int count)
+{
+    if(buffer == NULL || data == NULL) return SBUFFER_FAILURE;
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    if(atomic_load_explicit(&(buffer->spilling), memory_order_acquire)) // keep the order, new readings queue up behind the spilled ones
+    {
+        pthread_mutex_lock(&(buffer->spill_lock));
+        if(atomic_load_explicit(&(buffer->spilling), memory_order_relaxed))
+        {
+            _spill(buffer, data, (size_t) count);
+            pthread_mutex_unlock(&(buffer->spill_lock));
+            sbuffer_waitq_notify(&(buffer->waitq)); // readers may have space to drain into
+
+            return SBUFFER_SUCCESS;
+        }
+        pthread_mutex_unlock(&(buffer->spill_lock)); // readers drained the spill meanwhile
+    }
+    #endif
+
+    size_t head = atomic_load_explicit(&(buffer->head), memory_order_relaxed); // single producer, nobody else moves the head
+    size_t done = 0;
+    uint64_t now = sbuffer_clock_us();
+    while(done < (size_t) count) // a batch larger than the free space is published in several chunks
+    {
+        size_t free_slots = RING_CAPACITY - (head - _slowest_cursor(buffer));
+        if(free_slots == 0)
+        {
+            #if (SBUFFER_POLICY == SBUFFER_POLICY_BLOCK)
+            atomic_fetch_add_explicit(&(buffer->blocked), 1, memory_order_relaxed);
+            _wait_for_space(buffer);
+            #elif (SBUFFER_POLICY == SBUFFER_POLICY_DROP_OLDEST)
+            _drop_oldest(buffer); // the oldest reading of the whole ring goes, not one of the inserting sensor
+            #elif (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+            pthread_mutex_lock(&(buffer->spill_lock));
+            _spill(buffer, &(data[done]), (size_t) count - done);
+            atomic_store_explicit(&(buffer->spilling), 1, memory_order_release); // from now on readers own the ring's head
+            pthread_mutex_unlock(&(buffer->spill_lock));
+            break;
+            #else
+            atomic_fetch_add_explicit(&(buffer->dropped), (size_t) count - done, memory_order_relaxed);
+            break;
+            #endif
+            continue;
+        }
+        if(free_slots > (size_t) count - done) free_slots = (size_t) count - done;
+
+        for(size_t i = 0; i < free_slots; i++)
+        {
+            buffer->ring[(head+i) & buffer->mask] = data[done+i];
+            buffer->enqueued[(head+i) & buffer->mask] = now;
+        }
+        head += free_slots;
+        done += free_slots;
+        atomic_store_explicit(&(buffer->head), head, memory_order_release); // one publication for the whole chunk
+        if(done < (size_t) count) sbuffer_waitq_notify(&(buffer->waitq)); // readers must see this chunk before space frees up for the rest
+    }
+    sbuffer_waitq_notify(&(buffer->waitq));
+
+    return SBUFFER_SUCCESS;
+}
+
+int sbuffer_reserve(sbuffer_t * buffer, sensor_data_t ** slots, int count)
+{
+    if(buffer == NULL || slots == NULL || count <= 0) return SBUFFER_FAILURE;
+
+    size_t head = atomic_load_explicit(&(buffer->head), memory_order_relaxed);
+    size_t free_slots = 0;
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    if(!atomic_load_explicit(&(buffer->spilling), memory_order_acquire)) // new readings queue up behind the spilled ones, see sbuffer_commit
+    #endif
+    free_slots = RING_CAPACITY - (head - _slowest_cursor(buffer));
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_BLOCK)
+    while(free_slots == 0)
+    {
+        atomic_fetch_add_explicit(&(buffer->blocked), 1, memory_order_relaxed);
+        _wait_for_space(buffer);
+        free_slots = RING_CAPACITY - (head - _slowest_cursor(buffer));
+    }
+    #elif (SBUFFER_POLICY == SBUFFER_POLICY_DROP_OLDEST)
+    if(free_slots == 0)
+    {
+        _drop_oldest(buffer);
+        free_slots = 1;
+    }
+    #endif
+
+    if(free_slots == 0) // drop-newest or spill, the readings are staged and the policy applied on commit
+    {
+        buffer->staged = 1;
+        *slots = buffer->staging;
+
+        return (count < SBUFFER_BATCH_SIZE) ? count : SBUFFER_BATCH_SIZE;
+    }
+
+    if(free_slots > SBUFFER_RING_SIZE - (head & buffer->mask)) free_slots = SBUFFER_RING_SIZE - (head & buffer->mask); // contiguous up to the end of the ring
+    if(free_slots > (size_t) count) free_slots = (size_t) count;
+    buffer->staged = 0;
+    *slots = &(buffer->ring[head & buffer->mask]); // every reader moved past these slots, nobody reads them before the head does
+
+    return (int) free_slots;
+}
+
+int sbuffer_commit(sbuffer_t * buffer, int count)
+{
+    if(buffer == NULL || count < 0) return SBUFFER_FAILURE;
+    if(buffer->staged)
+    {
+        buffer->staged = 0;
+
+        return (count > 0) ? sbuffer_insert_batch(buffer, buffer->staging, count) : SBUFFER_SUCCESS;
+    }
+    if(count == 0) return SBUFFER_SUCCESS;
+
+    size_t head = atomic_load_explicit(&(buffer->head), memory_order_relaxed);
+    uint64_t now = sbuffer_clock_us();
+    for(int i = 0; i < count; i++) buffer->enqueued[(head+i) & buffer->mask] = now;
+    atomic_store_explicit(&(buffer->head), head + (size_t) count, memory_order_release); // readings written in place become visible at once
+    sbuffer_waitq_notify(&(buffer->waitq));
+
+    return SBUFFER_SUCCESS;
+}
+
+int sbuffer_wait(sbuffer_t * buffer, int readby, int timeout_ms)
+{
+    if(buffer == NULL || readby < 0 || readby >= SBUFFER_MAX_READERS || atomic_load_explicit(&(buffer->readers[readby].live), memory_order_relaxed) != READER_LIVE) return SBUFFER_FAILURE;
+
+    for(int i = 0; i < SBUFFER_WAIT_SPINS; i++) // data usually arrives in bursts, stay on the CPU for a moment before sleeping
+    {
+        if(_has_data(buffer, readby)) return SBUFFER_SUCCESS;
+        CPU_RELAX();
+    }
+
+    unsigned int key = sbuffer_waitq_prepare(&(buffer->waitq));
+    if(_has_data(buffer, readby))
+    {
+        sbuffer_waitq_cancel(&(buffer->waitq));
+
+        return SBUFFER_SUCCESS;
+    }
+    sbuffer_waitq_commit(&(buffer->waitq), key, timeout_ms);
+
+    return _has_data(buffer, readby) ? SBUFFER_SUCCESS : SBUFFER_NO_DATA;
+}
+
+void sbuffer_wakeup(sbuffer_t * buffer)
+{
+    if(buffer != NULL) sbuffer_waitq_notify(&(buffer->waitq));
+}
+
+size_t sbuffer_depth(sbuffer_t * buffer)
+{
+    size_t head = atomic_load_explicit(&(buffer->head), memory_order_acquire);
+    size_t depth = 0;
+    for(int i = 0; i < SBUFFER_MAX_READERS; i++)
+    {
+        if(atomic_load_explicit(&(buffer->readers[i].live), memory_order_acquire) != READER_LIVE) continue;
+
+        size_t lag = head - atomic_load_explicit(&(buffer->readers[i].cursor), memory_order_relaxed);
+        if(lag <= SBUFFER_RING_SIZE && lag > depth) depth = lag; // a cursor that moved past 'head' meanwhile wraps around to a huge lag
+    }
+
+    return depth;
+}
+
+void sbuffer_get_stats(sbuffer_t * buffer, sbuffer_stats_t * stats)
+{
+    stats->depth = atomic_load_explicit(&(buffer->head), memory_order_acquire) - _slowest_cursor(buffer);
+    stats->capacity = RING_CAPACITY;
+    stats->high_water = RING_CAPACITY * SBUFFER_HIGH_WATER / 100;
+    stats->low_water = RING_CAPACITY * SBUFFER_LOW_WATER / 100;
+    stats->policy = SBUFFER_POLICY;
+    stats->dropped = atomic_load_explicit(&(buffer->dropped), memory_order_relaxed);
+    stats->blocked = atomic_load_explicit(&(buffer->blocked), memory_order_relaxed);
+    stats->spilled = atomic_load_explicit(&(buffer->spilled), memory_order_relaxed);
+
+    size_t head = atomic_load_explicit(&(buffer->head), memory_order_acquire);
+    for(int i = 0; i < SBUFFER_MAX_READERS; i++)
+    {
+        sbuffer_reader_stats_t * reader = &(stats->readers[i]);
+        reader->live = (atomic_load(&(buffer->readers[i].live)) == READER_LIVE);
+        reader->lag = reader->live ? head - atomic_load_explicit(&(buffer->readers[i].cursor), memory_order_acquire) : 0;
+        reader->read = atomic_load_explicit(&(buffer->readers[i].read), memory_order_relaxed);
+        for(int j = 0; j < SBUFFER_LATENCY_BUCKETS; j++) reader->latency[j] = atomic_load_explicit(&(buffer->readers[i].latency[j]), memory_order_relaxed);
+    }
+}
+
+void sbuffer_print_content(sbuffer_t * buffer)
+{
+    sbuffer_stats_t stats;
+    sbuffer_get_stats(buffer, &stats);
+
+    printf("\n##### Printing SBUFFER Content Summary #####\n");
+    sbuffer_print_stats(&stats);
+}
+
+static size_t _slowest_cursor(sbuffer_t * buffer)
+{
+    size_t head = atomic_load_explicit(&(buffer->head), memory_order_relaxed);
+    size_t oldest = head;
+    for(int i = 0; i < SBUFFER_MAX_READERS; i++) // live reader with the most unread readings defines how far the producer may go
+    {
+        if(atomic_load(&(buffer->readers[i].live)) != READER_LIVE) continue; // acquire, a cursor is set before its slot turns live
+        size_t cursor = atomic_load_explicit(&(buffer->readers[i].cursor), memory_order_acquire);
+        if(head - cursor > head - oldest) oldest = cursor;
+    }
+    return oldest;
+}
+
+static int _has_data(sbuffer_t * buffer, int readby)
+{
+    size_t head = atomic_load_explicit(&(buffer->head), memory_order_acquire);
+    if(atomic_load_explicit(&(buffer->readers[readby].cursor), memory_order_relaxed) != head) return 1;
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+    return atomic_load_explicit(&(buffer->spilling), memory_order_acquire) && (head - _slowest_cursor(buffer) < RING_CAPACITY); // the reader can drain the spill
+    #else
+    return 0;
+    #endif
+}
+
+// Moves the cursor of 'readby' from 'cursor' past 'count' slots, fails if the producer dropped readings under it meanwhile
+static int _advance_cursor(sbuffer_t * buffer, int readby, size_t cursor, size_t count)
+{
+    int res = 1;
+
+    #if (SBUFFER_POLICY == SBUFFER_POLICY_DROP_OLDEST)
+    res = atomic_compare_exchange_strong(&(buffer->readers[readby].cursor), &cursor, cursor+count);
+    #else
+    atomic_store_explicit(&(buffer->readers[readby].cursor), cursor+count, memory_order_release); // only this reader writes its cursor
+    #endif
+
+    if(res) sbuffer_waitq_notify(&(buffer->spaceq));
+
+    return res;
+}
+
+// Adds a popped batch to the counters of 'readby', only the reader itself writes them
+static void _count_reads(sbuffer_t * buffer, int readby, unsigned long * latency, size_t count)
+{
+    sbuffer_reader_t * reader = &(buffer->readers[readby]);
+
+    atomic_store_explicit(&(reader->read), atomic_load_explicit(&(reader->read), memory_order_relaxed) + count, memory_order_relaxed);
+    for(int i = 0; i < SBUFFER_LATENCY_BUCKETS; i++)
+    {
+        if(latency[i] > 0) atomic_store_explicit(&(reader->latency[i]), atomic_load_explicit(&(reader->latency[i]), memory_order_relaxed) + latency[i], memory_order_relaxed);
+    }
+}
+
+// Moves every reader still pointing at the oldest reading past it, the slot may be overwritten afterwards
+static void _drop_oldest(sbuffer_t * buffer)
+{
+    size_t oldest = _slowest_cursor(buffer);
+    for(int i = 0; i < SBUFFER_MAX_READERS; i++)
+    {
+        size_t expected = oldest;
+        atomic_compare_exchange_strong(&(buffer->readers[i].cursor), &expected, oldest+1);
+    }
+    atomic_fetch_add_explicit(&(buffer->dropped), 1, memory_order_relaxed);
+}
+
+#if (SBUFFER_POLICY == SBUFFER_POLICY_BLOCK)
+static void _wait_for_space(sbuffer_t * buffer)
+{
+    unsigned int key = sbuffer_waitq_prepare(&(buffer->spaceq));
+    size_t head = atomic_load_explicit(&(buffer->head), memory_order_relaxed);
+
+    if(head - _slowest_cursor(buffer) >= RING_CAPACITY) sbuffer_waitq_commit(&(buffer->spaceq), key, SBUFFER_WAIT_TIMEOUT);
+    else sbuffer_waitq_cancel(&(buffer->spaceq));
+}
+#endif
+
+#if (SBUFFER_POLICY == SBUFFER_POLICY_SPILL)
+// Appends readings to the spill, must be called with 'spill_lock' held
+static void _spill(sbuffer_t * buffer, sensor_data_t * data, size_t count)
+{
+    size_t spilled = (size_t) sbuffer_spill_append(buffer->spill, data, (int) count);
+    if(spilled < count) atomic_fetch_add_explicit(&(buffer->dropped), count - spilled, memory_order_relaxed); // out of segments
+    atomic_store_explicit(&(buffer->spilled), sbuffer_spill_size(buffer->spill), memory_order_relaxed);
+}
+
+// Moves spilled readings into the free slots of the ring, skipped if another thread holds the spill
+static void _drain_spill(sbuffer_t * buffer)
+{
+    if(!atomic_load_explicit(&(buffer->spilling), memory_order_acquire)) return;
+    if(pthread_mutex_trylock(&(buffer->spill_lock)) != 0) return;
+
+    sensor_data_t chunk[SBUFFER_BATCH_SIZE];
+    uint64_t now = sbuffer_clock_us(); // latency is counted from here, time spent on disk is not included
+    size_t head = atomic_load_explicit(&(buffer->head), memory_order_relaxed); // this thread is the producer while it holds the lock
+    int drained = 0;
+
+    while(atomic_load_explicit(&(buffer->spilling), memory_order_relaxed))
+    {
+        size_t free_slots = RING_CAPACITY - (head - _slowest_cursor(buffer));
+        if(free_slots == 0) break;
+
+        int size = sbuffer_spill_read(buffer->spill, chunk, (free_slots < SBUFFER_BATCH_SIZE) ? (int) free_slots : SBUFFER_BATCH_SIZE);
+        for(int i = 0; i < size; i++)
+        {
+            buffer->ring[(head+i) & buffer->mask] = chunk[i];
+            buffer->enqueued[(head+i) & buffer->mask] = now;
+        }
+        head += size;
+        drained += size;
+        atomic_store_explicit(&(buffer->head), head, memory_order_release);
+        if(sbuffer_spill_size(buffer->spill) == 0) atomic_store_explicit(&(buffer->spilling), 0, memory_order_release); // connmgr owns the head again
+    }
+    atomic_store_explicit(&(buffer->spilled), sbuffer_spill_size(buffer->spill), memory_order_relaxed);
+    pthread_mutex_unlock(&(buffer->spill_lock));
+
+    if(drained > 0) sbuffer_waitq_notify(&(buffer->waitq));
+}
+#endif
@@ -0,0 +1,220 @@
+/***************************************************************************************************
+ *
+ * FileName:        sbuffer_shard.c
+ * Comment:         Shared buffer split in independent shards by sensor id, lets several datamgr
+ *                  and storagemgr threads consume readings in parallel
+ * Dependencies:    Header (.h) files sbuffer_shard.h
+ *
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Author                       Date            Version       Comment
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Maxim Yudayev                16/10/2026      1.0           Built on top of the sbuffer.h interface
+ *                                                            only, each shard keeps the engine's
+ *                                                            ordering and backpressure guarantees
+ *                              16/10/2026      1.1           Producers of a shard take turns, so
+ *                                                            several connmgr workers can insert at
+ *                                                            once into single-producer engines
+ *                              16/10/2026      1.2           Reservations, a producer keeps a shard
+ *                                                            from reserve to commit and can tell when
+ *                                                            another one waits for it
+ *                              16/10/2026      1.3           sbuffer_shard_depth, lock-free fill
+ *                                                            level of the fullest shard
+ *                              16/10/2026      1.4           sbuffer_shard_insert_batch removed,
+ *                                                            producers reserve and commit instead
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ ***************************************************************************************************/
+
+/**
+ * Includes
+ **/
+#define _GNU_SOURCE
+#define BUILDING_GATEWAY
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "sbuffer_shard.h"
+#include "config.h"
+
+/**
+ * Custom Types
+ **/
+struct sbuffer_shard {
+    int count;
+    sbuffer_t ** buffers;
+    pthread_mutex_t * producer_locks;   // one per shard, the ring engine has a single producer
+    atomic_int * waiting;               // producers blocked on each producer lock
+};
+
+/**
+ * Private Prototypes
+ **/
+static void _lock(sbuffer_shard_t * shards, int index);
+
+/**
+ * Functions
+ **/
+//
+int sbuffer_shard_init(sbuffer_shard_t ** shards, int count)
+{
+    if(shards == NULL || count <= 0 || count > 255) return SBUFFER_FAILURE; // shard indices are kept in bytes
+
+    *shards = malloc(sizeof(sbuffer_shard_t));
+    if(*shards == NULL) return SBUFFER_FAILURE;
+
+    (*shards)->buffers = calloc(count, sizeof(sbuffer_t *));
+    (*shards)->producer_locks = malloc(count*sizeof(pthread_mutex_t));
+    (*shards)->waiting = malloc(count*sizeof(atomic_int));
+    (*shards)->count = count;
+    if((*shards)->buffers == NULL || (*shards)->producer_locks == NULL || (*shards)->waiting == NULL)
+    {
+        free((*shards)->buffers);
+        free((*shards)->producer_locks);
+        free((*shards)->waiting);
+        free(*shards);
+        *shards = NULL;
+
+        return SBUFFER_FAILURE;
+    }
+
+    for(int i = 0; i < count; i++)
+    {
+        pthread_mutex_init(&((*shards)->producer_locks[i]), NULL);
+        atomic_init(&((*shards)->waiting[i]), 0);
+    }
+    for(int i = 0; i < count; i++)
+    {
+        if(sbuffer_init(&((*shards)->buffers[i])) != SBUFFER_SUCCESS)
+        {
+            sbuffer_shard_free(shards);
+
+            return SBUFFER_FAILURE;
+        }
+    }
+
+    return SBUFFER_SUCCESS;
+}
+
+int sbuffer_shard_free(sbuffer_shard_t ** shards)
+{
+    if(shards == NULL || *shards == NULL) return SBUFFER_FAILURE;
+
+    for(int i = 0; i < (*shards)->count; i++)
+    {
+        if((*shards)->buffers[i] != NULL) sbuffer_free(&((*shards)->buffers[i]));
+        pthread_mutex_destroy(&((*shards)->producer_locks[i]));
+    }
+    free((*shards)->buffers);
+    free((*shards)->producer_locks);
+    free((*shards)->waiting);
+    free(*shards);
+    *shards = NULL;
+
+    return SBUFFER_SUCCESS;
+}
+
+int sbuffer_shard_count(sbuffer_shard_t * shards)
+{
+    return shards->count;
+}
+
+sbuffer_t * sbuffer_shard_get(sbuffer_shard_t * shards, int index)
+{
+    return (index >= 0 && index < shards->count) ? shards->buffers[index] : NULL;
+}
+
+int sbuffer_shard_of(sbuffer_shard_t * shards, sensor_id_t id)
+{
+    return (int) ((((uint32_t) id * 2654435761u) >> 16) % (uint32_t) shards->count); // multiplicative hash, consecutive ids spread over all shards
+}
+
+int sbuffer_shard_reserve(sbuffer_shard_t * shards, int index, sensor_data_t ** slots, int count, int wait)
+{
+    if(shards == NULL || index < 0 || index >= shards->count) return SBUFFER_FAILURE;
+
+    if(!wait && pthread_mutex_trylock(&(shards->producer_locks[index])) != 0) return SBUFFER_PENDING;
+    if(wait) _lock(shards, index);
+
+    int res = sbuffer_reserve(shards->buffers[index], slots, count);
+    if(res == SBUFFER_FAILURE) pthread_mutex_unlock(&(shards->producer_locks[index]));
+
+    return res;
+}
+
+int sbuffer_shard_commit(sbuffer_shard_t * shards, int index, int count)
+{
+    int res = sbuffer_commit(shards->buffers[index], count);
+    pthread_mutex_unlock(&(shards->producer_locks[index]));
+
+    return res;
+}
+
+int sbuffer_shard_contended(sbuffer_shard_t * shards, int index)
+{
+    return atomic_load_explicit(&(shards->waiting[index]), memory_order_relaxed) > 0;
+}
+
+void sbuffer_shard_wakeup(sbuffer_shard_t * shards)
+{
+    if(shards == NULL) return;
+
+    for(int i = 0; i < shards->count; i++) sbuffer_wakeup(shards->buffers[i]);
+}
+
+void sbuffer_shard_get_stats(sbuffer_shard_t * shards, sbuffer_stats_t * stats)
+{
+    sbuffer_stats_t shard_stats;
+    sbuffer_reader_stats_t readers[SBUFFER_MAX_READERS] = {0};
+    unsigned long dropped = 0, blocked = 0;
+    size_t spilled = 0;
+
+    for(int i = 0; i < shards->count; i++)
+    {
+        sbuffer_get_stats(shards->buffers[i], &shard_stats);
+        dropped += shard_stats.dropped;
+        blocked += shard_stats.blocked;
+        spilled += shard_stats.spilled;
+        for(int r = 0; r < SBUFFER_MAX_READERS; r++) // every shard subscribes its readers in the same order
+        {
+            readers[r].live |= shard_stats.readers[r].live;
+            if(shard_stats.readers[r].lag > readers[r].lag) readers[r].lag = shard_stats.readers[r].lag;
+            readers[r].read += shard_stats.readers[r].read;
+            for(int b = 0; b < SBUFFER_LATENCY_BUCKETS; b++) readers[r].latency[b] += shard_stats.readers[r].latency[b];
+        }
+        if(i == 0 || shard_stats.depth > stats->depth) *stats = shard_stats; // the fullest shard decides on backpressure
+    }
+    stats->dropped = dropped;
+    stats->blocked = blocked;
+    stats->spilled = spilled;
+    for(int r = 0; r < SBUFFER_MAX_READERS; r++) stats->readers[r] = readers[r];
+}
+
+size_t sbuffer_shard_depth(sbuffer_shard_t * shards)
+{
+    size_t depth = 0;
+    for(int i = 0; i < shards->count; i++)
+    {
+        size_t shard_depth = sbuffer_depth(shards->buffers[i]);
+        if(shard_depth > depth) depth = shard_depth;
+    }
+
+    return depth;
+}
+
+void sbuffer_shard_print_content(sbuffer_shard_t * shards)
+{
+    for(int i = 0; i < shards->count; i++)
+    {
+        printf("\n##### Shard %d of %d #####", i, shards->count);
+        sbuffer_print_content(shards->buffers[i]);
+    }
+}
+
+// Takes the producer lock of shard 'index', announced so that a producer holding it on to a reservation lets go
+static void _lock(sbuffer_shard_t * shards, int index)
+{
+    atomic_fetch_add_explicit(&(shards->waiting[index]), 1, memory_order_relaxed);
+    pthread_mutex_lock(&(shards->producer_locks[index]));
+    atomic_fetch_sub_explicit(&(shards->waiting[index]), 1, memory_order_relaxed);
+}
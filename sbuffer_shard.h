@@ -0,0 +1,75 @@
+#ifndef _SBUFFER_SHARD_H_
+#define _SBUFFER_SHARD_H_
+
+#include "config.h"
+#include "sbuffer.h"
+
+/**
+ * Set of independent shared buffers, a reading goes to the shard its sensor id hashes to
+ * Every shard has its own readers, so readings of one sensor stay in order while readings of
+ * different sensors are consumed in parallel. Works with either sbuffer engine
+ **/
+typedef struct sbuffer_shard sbuffer_shard_t;
+
+/**
+ * Allocates 'count' shared buffers, at most 255
+ * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured
+ **/
+int sbuffer_shard_init(sbuffer_shard_t ** shards, int count);
+
+/**
+ * Frees all shards and the set itself
+ * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured
+ **/
+int sbuffer_shard_free(sbuffer_shard_t ** shards);
+
+int sbuffer_shard_count(sbuffer_shard_t * shards);
+
+/**
+ * Returns the shared buffer of shard 'index', readers subscribe to and pop from it directly
+ **/
+sbuffer_t * sbuffer_shard_get(sbuffer_shard_t * shards, int index);
+
+/**
+ * Returns the index of the shard readings of sensor 'id' are inserted in
+ **/
+int sbuffer_shard_of(sbuffer_shard_t * shards, sensor_id_t id);
+
+/**
+ * Takes the producer lock of shard 'index' and calls sbuffer_reserve on it, see sbuffer.h, the lock
+ * is held until sbuffer_shard_commit. If 'wait' is 0 and another producer holds the shard, returns
+ * SBUFFER_PENDING right away. A producer must not wait for a shard while it holds another one
+ * Returns the number of slots reserved, SBUFFER_PENDING or SBUFFER_FAILURE
+ **/
+int sbuffer_shard_reserve(sbuffer_shard_t * shards, int index, sensor_data_t ** slots, int count, int wait);
+
+/**
+ * Calls sbuffer_commit on shard 'index' and releases it
+ * Returns SBUFFER_SUCCESS on success and SBUFFER_FAILURE if an error occured
+ **/
+int sbuffer_shard_commit(sbuffer_shard_t * shards, int index, int count);
+
+/**
+ * Returns whether a producer waits for shard 'index', its holder should commit soon
+ **/
+int sbuffer_shard_contended(sbuffer_shard_t * shards, int index);
+
+/**
+ * Calls sbuffer_wakeup on every shard
+ **/
+void sbuffer_shard_wakeup(sbuffer_shard_t * shards);
+
+/**
+ * Combined statistics: depth, capacity and water marks of the fullest shard, counters summed up
+ * Readers are matched by their sbuffer_subscribe handle, lag is the largest over all shards
+ **/
+void sbuffer_shard_get_stats(sbuffer_shard_t * shards, sbuffer_stats_t * stats);
+
+/**
+ * Largest sbuffer_depth over all shards, without taking any lock
+ **/
+size_t sbuffer_shard_depth(sbuffer_shard_t * shards);
+
+void sbuffer_shard_print_content(sbuffer_shard_t * shards);
+
+#endif /* _SBUFFER_SHARD_H_ */
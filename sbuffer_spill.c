@@ -0,0 +1,194 @@
+/***************************************************************************************************
+ *
+ * FileName:        sbuffer_spill.c
+ * Comment:         Overflow of the shared buffer to memory-mapped segment files
+ * Dependencies:    Header (.h) files sbuffer_spill.h
+ *
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Author                       Date            Version       Comment
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Maxim Yudayev                16/10/2026      1.0           Segments are written and read strictly in
+ *                                                            order, a segment is unmapped as soon as
+ *                                                            its last record was read, so disk usage
+ *                                                            follows the backlog
+ * Maxim Yudayev                16/10/2026      1.1           Segment blocks are allocated up front, a
+ *                                                            full disk drops the reading instead of
+ *                                                            faulting on the mapping
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * Written pages are shared file mappings, hence the kernel may write them back and evict them under
+ * memory pressure instead of the heap growing with the backlog.
+ *
+ ***************************************************************************************************/
+
+/**
+ * Includes
+ **/
+#define _GNU_SOURCE
+#define BUILDING_GATEWAY
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "sbuffer_spill.h"
+#include "config.h"
+
+#define SEGMENT_BYTES (sizeof(sensor_data_t) * (size_t) SBUFFER_SPILL_SEGMENT)
+
+/**
+ * Custom Types
+ **/
+typedef struct spill_segment {
+    struct spill_segment * next;
+    sensor_data_t * records;    // mapping of the whole segment file
+    size_t written;
+    size_t read;
+} spill_segment_t;
+
+struct sbuffer_spill {
+    spill_segment_t * oldest;   // segment read from
+    spill_segment_t * newest;   // segment appended to
+    size_t segments;
+    size_t size;
+};
+
+/**
+ * Private Prototypes
+ **/
+static spill_segment_t * _segment_create(void);
+static void _segment_destroy(spill_segment_t * segment);
+
+/**
+ * Functions
+ **/
+//
+int sbuffer_spill_init(sbuffer_spill_t ** spill)
+{
+    *spill = malloc(sizeof(sbuffer_spill_t));
+    if(*spill == NULL) return SBUFFER_SPILL_FAILURE;
+
+    (*spill)->oldest = (*spill)->newest = NULL;
+    (*spill)->segments = 0;
+    (*spill)->size = 0;
+
+    return SBUFFER_SPILL_SUCCESS;
+}
+
+void sbuffer_spill_free(sbuffer_spill_t ** spill)
+{
+    if(spill == NULL || *spill == NULL) return;
+
+    while((*spill)->oldest != NULL)
+    {
+        spill_segment_t * segment = (*spill)->oldest;
+        (*spill)->oldest = segment->next;
+        _segment_destroy(segment);
+    }
+    free(*spill);
+    *spill = NULL;
+}
+
+int sbuffer_spill_append(sbuffer_spill_t * spill, sensor_data_t * data, int count)
+{
+    int done = 0;
+
+    while(done < count)
+    {
+        if(spill->newest == NULL || spill->newest->written == SBUFFER_SPILL_SEGMENT) // current segment is full
+        {
+            if(spill->segments == SBUFFER_SPILL_MAX_SEGMENTS) break;
+
+            spill_segment_t * segment = _segment_create();
+            if(segment == NULL) break;
+
+            if(spill->newest == NULL) spill->oldest = segment;
+            else spill->newest->next = segment;
+            spill->newest = segment;
+            spill->segments++;
+        }
+
+        size_t chunk = SBUFFER_SPILL_SEGMENT - spill->newest->written;
+        if(chunk > (size_t) (count - done)) chunk = (size_t) (count - done);
+        memcpy(&(spill->newest->records[spill->newest->written]), &(data[done]), chunk * sizeof(sensor_data_t));
+        spill->newest->written += chunk;
+        spill->size += chunk;
+        done += (int) chunk;
+    }
+
+    return done;
+}
+
+int sbuffer_spill_read(sbuffer_spill_t * spill, sensor_data_t * data, int max)
+{
+    int done = 0;
+
+    while(done < max && spill->oldest != NULL)
+    {
+        spill_segment_t * segment = spill->oldest;
+        size_t chunk = segment->written - segment->read;
+        if(chunk > (size_t) (max - done)) chunk = (size_t) (max - done);
+
+        memcpy(&(data[done]), &(segment->records[segment->read]), chunk * sizeof(sensor_data_t));
+        segment->read += chunk;
+        spill->size -= chunk;
+        done += (int) chunk;
+
+        if(segment->read < segment->written) break; // caught up with the producer in this segment
+        if(segment->read == SBUFFER_SPILL_SEGMENT) // drained for good, give the file back
+        {
+            spill->oldest = segment->next;
+            if(spill->oldest == NULL) spill->newest = NULL;
+            spill->segments--;
+            _segment_destroy(segment);
+        } else break;
+    }
+
+    return done;
+}
+
+size_t sbuffer_spill_size(sbuffer_spill_t * spill)
+{
+    return spill->size;
+}
+
+static spill_segment_t * _segment_create(void)
+{
+    char path[] = SBUFFER_SPILL_DIR "/sbuffer_spill_XXXXXX";
+    int fd = mkstemp(path);
+    if(fd == -1) return NULL;
+
+    unlink(path); // only the mapping keeps the file alive
+    if(posix_fallocate(fd, 0, SEGMENT_BYTES) != 0) // reserve the blocks now, a store into an unbacked page of a full disk raises SIGBUS
+    {
+        close(fd);
+
+        return NULL;
+    }
+
+    spill_segment_t * segment = malloc(sizeof(spill_segment_t));
+    void * records = mmap(NULL, SEGMENT_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); // the mapping holds its own reference to the file
+    if(segment == NULL || records == MAP_FAILED)
+    {
+        free(segment);
+        if(records != MAP_FAILED) munmap(records, SEGMENT_BYTES);
+
+        return NULL;
+    }
+    madvise(records, SEGMENT_BYTES, MADV_SEQUENTIAL);
+
+    segment->next = NULL;
+    segment->records = (sensor_data_t *) records;
+    segment->written = 0;
+    segment->read = 0;
+
+    return segment;
+}
+
+static void _segment_destroy(spill_segment_t * segment)
+{
+    munmap(segment->records, SEGMENT_BYTES);
+    free(segment);
+}
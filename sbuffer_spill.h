@@ -0,0 +1,46 @@
+#ifndef _SBUFFER_SPILL_H_
+#define _SBUFFER_SPILL_H_
+
+#include <stddef.h>
+#include "config.h"
+
+#define SBUFFER_SPILL_FAILURE -1
+#define SBUFFER_SPILL_SUCCESS 0
+
+/**
+ * FIFO of readings kept in memory-mapped segment files of SBUFFER_SPILL_SEGMENT fixed-size records,
+ * used by the shared buffer engines as overflow while the buffer is full (SBUFFER_POLICY_SPILL)
+ * Segment files are created in SBUFFER_SPILL_DIR and unlinked right away, so the kernel reclaims
+ * them once unmapped, even if the gateway crashes. Not thread-safe, callers serialize access
+ **/
+typedef struct sbuffer_spill sbuffer_spill_t;
+
+/**
+ * Returns SBUFFER_SPILL_SUCCESS on success and SBUFFER_SPILL_FAILURE if an error occured
+ **/
+int sbuffer_spill_init(sbuffer_spill_t ** spill);
+
+/**
+ * Unmaps and closes all segments, spilled readings are lost
+ **/
+void sbuffer_spill_free(sbuffer_spill_t ** spill);
+
+/**
+ * Appends the 'count' readings of the array 'data', adding segments as needed
+ * Returns the number of readings appended, less than 'count' once SBUFFER_SPILL_MAX_SEGMENTS
+ * segments are in use or a segment could not be created
+ **/
+int sbuffer_spill_append(sbuffer_spill_t * spill, sensor_data_t * data, int count);
+
+/**
+ * Removes up to 'max' of the oldest readings and copies them into the array 'data'
+ * Returns the number of readings copied
+ **/
+int sbuffer_spill_read(sbuffer_spill_t * spill, sensor_data_t * data, int max);
+
+/**
+ * Returns the number of readings currently spilled
+ **/
+size_t sbuffer_spill_size(sbuffer_spill_t * spill);
+
+#endif /* _SBUFFER_SPILL_H_ */
@@ -15,6 +15,20 @@
  *                              07/01/2020      3.0           Previous issues are fixed, caused by
  *                                                            race condition with EOF signal of pipe
  *                                                            Completed
+ *                              16/10/2026      3.1           Readings consumed from shared buffer in
+ *                                                            batches, one transaction per batch,
+ *                                                            waits on the buffer when idle
+ *                              16/10/2026      3.2           State is thread local, one storagemgr
+ *                                                            thread and DB connection per shared
+ *                                                            buffer shard
+ *                              16/10/2026      3.3           End of the shared buffer is an atomic
+ *                                                            flag, no lock in the reader loop
+ *                              16/10/2026      3.4           Batches are bound to the database from
+ *                                                            the shared buffer's slots, no copies
+ *                              16/10/2026      3.5           A batch is only released once committed,
+ *                                                            failed ones are rolled back and retried,
+ *                                                            then storagemgr stops with
+ *                                                            STORAGEMGR_COMMIT_ERROR
  *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
  * TODO                         Date            Finished      Comment
  *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -53,14 +67,19 @@
 
 /**
  * Global Variables
+ * Thread local, every shard of the shared buffer is consumed by its own storagemgr thread
  **/
-static pthread_rwlock_t * sbuffer_open_rwlock;
-static pthread_mutex_t * ipc_pipe_mutex;
-static int * sbuffer_open;
-static int * retval;
-static int * pfds;
-static int readby;
-static int num_parsed_data;
+static _Thread_local pthread_mutex_t * ipc_pipe_mutex;
+static _Thread_local atomic_int * sbuffer_open;
+static _Thread_local int * retval;
+static _Thread_local int * pfds;
+static _Thread_local int readby;
+static _Thread_local int num_parsed_data;
+
+/**
+ * Private Prototypes
+ **/
+static int _store_batch(DBCONN * conn, const sensor_data_t ** batch, int batch_size);
 
 /**
  * Functions
@@ -68,7 +87,6 @@ static int num_parsed_data;
 // 
 void storagemgr_init(storagemgr_init_arg_t * arg)
 {
-    sbuffer_open_rwlock = arg->sbuffer_rwlock;
     sbuffer_open = arg->sbuffer_flag;
     retval = arg->status;
     readby = arg->id;
@@ -78,35 +96,36 @@ void storagemgr_init(storagemgr_init_arg_t * arg)
 
 void storagemgr_parse_sensor_data(DBCONN * conn, sbuffer_t ** buffer)
 {
-    void * node = NULL;
-    sensor_data_t data;
-    int sbuffer_res = SBUFFER_SUCCESS;
+    const sensor_data_t * batch[SBUFFER_BATCH_SIZE]; // readings stay in the shared buffer until released
+    int batch_size = 0, open = 1;
 
-    pthread_rwlock_rdlock(sbuffer_open_rwlock); // lock mutex to sbuffer_open shared data to prevent race condition during checking end of shared buffer
-    while(sbuffer_res != SBUFFER_NO_DATA || *sbuffer_open) // use condition variable from writer thread to know when to terminate the readers
+    while(batch_size != 0 || open) // use flag from writer thread to know when to terminate the readers
     {
-        pthread_rwlock_unlock(sbuffer_open_rwlock);
+        open = atomic_load_explicit(sbuffer_open, memory_order_acquire); // sampled before popping, once it reads 0 all readings are in the buffer
+        batch_size = sbuffer_peek_batch(*buffer, batch, SBUFFER_BATCH_SIZE, readby); // non-blocking, implementation takes care of thread-safety
 
-        sbuffer_res = sbuffer_pop(*buffer, &node, &data, readby); // non-blocking, implementation takes care of thread-safety
-
-        if(sbuffer_res != SBUFFER_SUCCESS) pthread_yield();
-        else if(sbuffer_res == SBUFFER_SUCCESS) 
+        if(batch_size == SBUFFER_FAILURE) break; // not subscribed, nothing will ever come
+        if(batch_size < 0 || (batch_size == 0 && open)) sbuffer_wait(*buffer, readby, SBUFFER_WAIT_TIMEOUT); // park until connmgr inserts data or closes the buffer
+        else if(batch_size > 0)
         {
-            num_parsed_data++;
-
-            #if (DEBUG_LVL > 1)
-            printf("Storage Manager: sbuffer data available %"PRIu16" %g %ld\n", data.id, data.value, data.ts);
-            fflush(stdout);
-            #endif
-
-            insert_sensor(conn, data.id, data.value, data.ts);
+            int attempts = 0, rc;
+            while((rc = _store_batch(conn, batch, batch_size)) != SQLITE_OK && ++attempts < STORAGE_COMMIT_ATTEMPTS); // e.g. SQLITE_BUSY once STORAGE_BUSY_TIMEOUT ran out
+
+            if(rc != SQLITE_OK) // keep the batch unreleased, the caller tears the gateway down
+            {
+                char * send_buf;
+                asprintf(&send_buf, "%ld Storage Manager: batch not stored after %d tries::%s", time(NULL), STORAGE_COMMIT_ATTEMPTS, sqlite3_errstr(rc));
+                write_to_pipe(ipc_pipe_mutex, pfds, send_buf);
+
+                *retval = STORAGEMGR_COMMIT_ERROR;
+                return;
+            }
+            num_parsed_data += batch_size;
+            sbuffer_release(*buffer, readby);
         }
 
         // usleep(100000);
-
-        pthread_rwlock_rdlock(sbuffer_open_rwlock); // lock mutex to sbuffer_open shared data to prevent race condition during checking end of shared buffer
     }
-    pthread_rwlock_unlock(sbuffer_open_rwlock);
 }
 
 DBCONN * init_connection(char clear_up_flag)
@@ -135,6 +154,7 @@ DBCONN * init_connection(char clear_up_flag)
     if(db != NULL)
     {
         char * sql;
+        sqlite3_busy_timeout(db, STORAGE_BUSY_TIMEOUT); // other storagemgr threads write to the same DB
         if(clear_up_flag == 1)
         {
             sql =   "DROP TABLE IF EXISTS "TO_STRING(TABLE_NAME)";"
@@ -190,6 +210,28 @@ void disconnect(DBCONN *conn)
     #endif
 }
 
+// Writes 'batch' in one transaction, rolled back if any statement fails. Returns the SQLite result code
+static int _store_batch(DBCONN * conn, const sensor_data_t ** batch, int batch_size)
+{
+    int rc = SQLITE_OK;
+
+    if(batch_size > 1) rc = sqlite3_exec(conn, "BEGIN TRANSACTION;", NULL, NULL, NULL); // one journal sync per batch instead of per reading
+    for(int i = 0; i < batch_size && rc == SQLITE_OK; i++)
+    {
+        #if (DEBUG_LVL > 1)
+        printf("Storage Manager: sbuffer data available %"PRIu16" %g %ld\n", batch[i]->id, batch[i]->value, batch[i]->ts);
+        fflush(stdout);
+        #endif
+
+        rc = insert_sensor(conn, batch[i]->id, batch[i]->value, batch[i]->ts);
+    }
+    if(batch_size > 1 && rc == SQLITE_OK) rc = sqlite3_exec(conn, "COMMIT;", NULL, NULL, NULL);
+
+    if(rc != SQLITE_OK && !sqlite3_get_autocommit(conn)) sqlite3_exec(conn, "ROLLBACK;", NULL, NULL, NULL); // a failed COMMIT leaves the transaction open, the next BEGIN would fail
+
+    return rc;
+}
+
 int insert_sensor(DBCONN * conn, sensor_id_t id, sensor_value_t value, sensor_ts_t ts)
 {
     char * errmsg;
@@ -86,7 +86,8 @@ int find_sensor_after_timestamp(DBCONN * conn, sensor_ts_t ts, callback_t f);
 
 /**
  * This method shares variables from threads space to carry out more functionality,
- * like having access to IPC mutex/rwlock and updating the return value of the thread
+ * like having access to IPC mutex and the atomic flags shared between threads and updating
+ * the return value of the thread
  **/
 void storagemgr_init(storagemgr_init_arg_t * arg);
 
@@ -8,8 +8,11 @@
 #include <unistd.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/time.h>
 #include "config.h"
 #include "lib/tcpsock.h"
+#include "sensor_proto.h"
 
 // conditional compilation option to control the number of measurements this sensor node wil generate
 #if (LOOPS > 1)
@@ -54,10 +57,32 @@
     #define LOG_CLOSE(...) (void)0
 #endif
 
+// conditional compilation options for the wire protocol, NODE_PROTO=1 sends unframed readings like older nodes
+#ifndef NODE_PROTO
+    #define NODE_PROTO PROTO_VERSION    // highest protocol version offered to the gateway
+#endif
+#ifndef NODE_BATCH
+    #define NODE_BATCH 16               // max. readings per frame, at most PROTO_FRAME_MAX
+#endif
+#ifndef NODE_ENCODING
+    #define NODE_ENCODING PROTO_ENC_RAW // encoding of the readings in a frame, PROTO_ENC_RAW unless the gateway speaks v3
+#endif
+#ifndef NODE_MAX_DELAY
+    #define NODE_MAX_DELAY 3            // max. seconds a reading waits for its frame to fill up, keep it below the TIMEOUT of the gateway
+#endif
+#if (NODE_BATCH > PROTO_FRAME_MAX || NODE_BATCH < 1)
+    #error NODE_BATCH out of range
+#endif
+#define NODE_HELLO_TIMEOUT 5            // seconds to wait for the gateway to answer the hello
+#define NODE_NO_HELLO 0                 // negotiate got no answer, the gateway predates the hello
+
 #define INITIAL_TEMPERATURE 	20
 #define TEMP_DEV 		5	// max afwijking vorige temperatuur in 0.1 celsius
 
 void print_help(void);
+static int send_all(tcpsock_t * client, unsigned char * buffer, int size);
+static int negotiate(tcpsock_t * client);
+static int send_frame(tcpsock_t * client, unsigned char * frame, int size, uint8_t encoding, sensor_id_t id, uint16_t count, sensor_ts_t base_ts);
 
 /*
  * argv[1] = sensor ID
@@ -73,7 +98,13 @@ int main(int argc, char *argv[])
     int server_port;
     char server_ip[] = "000.000.000.000"; 
     tcpsock_t * client;
-    int i, bytes, sleep_time;
+    int i, sleep_time, proto, size = 0;
+    unsigned char reading[PROTO_V1_READING_SIZE];
+    unsigned char frame[PROTO_FRAME_SIZE];
+    uint16_t count = 0;
+    uint8_t encoding;
+    sensor_ts_t base_ts = 0;
+    proto_codec_t codec;
 
     LOG_OPEN();
 
@@ -98,25 +129,60 @@ int main(int argc, char *argv[])
 
     // open TCP connection to the server; server is listening to SERVER_IP and PORT
     if(tcp_active_open(&client, server_port, server_ip) != TCP_NO_ERROR) exit(EXIT_FAILURE);
+    if((proto = negotiate(client)) == NODE_NO_HELLO) // the hello went out as the start of a v1 reading, only a new connection gets the stream aligned again
+    {
+        if(tcp_close(&client) != TCP_NO_ERROR || tcp_active_open(&client, server_port, server_ip) != TCP_NO_ERROR) exit(EXIT_FAILURE);
+        proto = PROTO_V1;
+    }
+    if(proto == -1) exit(EXIT_FAILURE);
+    encoding = (proto >= PROTO_V3) ? NODE_ENCODING : PROTO_ENC_RAW;
     data.value = INITIAL_TEMPERATURE; 
     i = LOOPS;
     while(i) 
     {
         data.value = data.value + TEMP_DEV * ((drand48() - 0.5)/10); 
         time(&data.ts);
-        // send data to server in this order (!!): <sensor_id><temperature><timestamp>
-        // remark: don't send as a struct!
-        bytes = sizeof(data.id);
-        if(tcp_send(client, (void *) &data.id, &bytes) != TCP_NO_ERROR) exit(EXIT_FAILURE);
-        bytes = sizeof(data.value);
-        if(tcp_send(client, (void *) &data.value, &bytes) != TCP_NO_ERROR) exit(EXIT_FAILURE);
-        bytes = sizeof(data.ts);
-        if(tcp_send(client, (void *) &data.ts, &bytes) != TCP_NO_ERROR) exit(EXIT_FAILURE);
+        if(proto == PROTO_V1)
+        {
+            // send data to server in this order (!!): <sensor_id><temperature><timestamp>
+            // remark: don't send as a struct! the fields are packed without padding and sent at once
+            memcpy(reading, &data.id, sizeof(data.id));
+            memcpy(&reading[sizeof(data.id)], &data.value, sizeof(data.value));
+            memcpy(&reading[sizeof(data.id) + sizeof(data.value)], &data.ts, sizeof(data.ts));
+            if(send_all(client, reading, sizeof(reading)) != TCP_NO_ERROR) exit(EXIT_FAILURE);
+        } else
+        {
+            // readings are collected in a frame, encoded relative to the ones before
+            if(count == 0)
+            {
+                base_ts = data.ts;
+                if(proto_codec_init(&codec, encoding, base_ts) == PROTO_FAILURE) exit(EXIT_FAILURE);
+                size = PROTO_HEADER_SIZE;
+            }
+            int len = proto_encode(&codec, &frame[size], data.value, data.ts);
+            if(len == PROTO_FAILURE) // clock moved too far from the base, the reading starts the next frame
+            {
+                if(send_frame(client, frame, size, encoding, data.id, count, base_ts) != TCP_NO_ERROR) exit(EXIT_FAILURE);
+                base_ts = data.ts;
+                if(proto_codec_init(&codec, encoding, base_ts) == PROTO_FAILURE) exit(EXIT_FAILURE);
+                size = PROTO_HEADER_SIZE;
+                count = 0;
+                len = proto_encode(&codec, &frame[size], data.value, data.ts);
+            }
+            size += len;
+            count++;
+            if(count == NODE_BATCH || size + PROTO_MAX_READING_SIZE > PROTO_FRAME_SIZE || data.ts + sleep_time - base_ts > NODE_MAX_DELAY) // full, or the next reading would wait too long
+            {
+                if(send_frame(client, frame, size, encoding, data.id, count, base_ts) != TCP_NO_ERROR) exit(EXIT_FAILURE);
+                count = 0;
+            }
+        }
         LOG_PRINTF(data.id, data.value, data.ts);
         sleep(sleep_time);
         UPDATE(i);
     }
 
+    if(count > 0 && send_frame(client, frame, size, encoding, data.id, count, base_ts) != TCP_NO_ERROR) exit(EXIT_FAILURE);
     if(tcp_close(&client) != TCP_NO_ERROR) exit(EXIT_FAILURE);
 
     LOG_CLOSE();
@@ -131,4 +197,67 @@ void print_help(void)
     printf("\t%-15s : node sleep time (in sec) between two measurements\n","\'sleep time\'");
     printf("\t%-15s : TCP server IP address\n", "\'server IP\'");
     printf("\t%-15s : TCP server port number\n", "\'server port\'");
-}
\ No newline at end of file
+}
+
+// sends all 'size' bytes of 'buffer', tcp_send may send less at once
+static int send_all(tcpsock_t * client, unsigned char * buffer, int size)
+{
+    int bytes, res;
+    while(size > 0)
+    {
+        bytes = size;
+        if((res = tcp_send(client, (void *) buffer, &bytes)) != TCP_NO_ERROR) return res;
+        buffer += bytes;
+        size -= bytes;
+    }
+    return TCP_NO_ERROR;
+}
+
+// offers NODE_PROTO to the gateway, returns the version the gateway answered with or -1 if the answer is not a hello
+// gateways that predate the hello never answer, after NODE_HELLO_TIMEOUT (or once they close) NODE_NO_HELLO is returned
+static int negotiate(tcpsock_t * client)
+{
+    unsigned char hello[PROTO_HELLO_SIZE];
+    uint16_t magic = PROTO_MAGIC;
+    struct timeval timeout = { .tv_sec = NODE_HELLO_TIMEOUT, .tv_usec = 0 }, no_timeout = { .tv_sec = 0, .tv_usec = 0 };
+    int sd, bytes, received = 0;
+
+    if(NODE_PROTO == PROTO_V1) return PROTO_V1;
+
+    memcpy(hello, &magic, sizeof(magic));
+    hello[sizeof(magic)] = NODE_PROTO;
+    if(send_all(client, hello, sizeof(hello)) != TCP_NO_ERROR) return -1;
+
+    tcp_get_sd(client, &sd);
+    setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    while(received < (int) sizeof(hello))
+    {
+        bytes = sizeof(hello) - received;
+        if(tcp_receive(client, (void *) &hello[received], &bytes) != TCP_NO_ERROR) return NODE_NO_HELLO;
+        received += bytes;
+    }
+    setsockopt(sd, SOL_SOCKET, SO_RCVTIMEO, &no_timeout, sizeof(no_timeout)); // back to blocking receives
+    memcpy(&magic, hello, sizeof(magic));
+    if(magic != PROTO_MAGIC || hello[sizeof(magic)] < PROTO_V1 || hello[sizeof(magic)] > NODE_PROTO) return -1;
+
+    return hello[sizeof(magic)];
+}
+
+// fills in the header <length><encoding><sensor_id><count><base_ts> in front of the 'count' readings of 'frame' and sends all 'size' bytes
+static int send_frame(tcpsock_t * client, unsigned char * frame, int size, uint8_t encoding, sensor_id_t id, uint16_t count, sensor_ts_t base_ts)
+{
+    uint16_t length = size - sizeof(length);
+    unsigned char * field = frame;
+
+    memcpy(field, &length, sizeof(length));
+    field += sizeof(length);
+    memcpy(field, &encoding, sizeof(encoding));
+    field += sizeof(encoding);
+    memcpy(field, &id, sizeof(id));
+    field += sizeof(id);
+    memcpy(field, &count, sizeof(count));
+    field += sizeof(count);
+    memcpy(field, &base_ts, sizeof(base_ts));
+
+    return send_all(client, frame, sizeof(length) + length);
+}
@@ -0,0 +1,189 @@
+/***************************************************************************************************
+ *
+ * FileName:        sensor_proto.c
+ * Comment:         Encodings of the readings inside a frame of the sensor wire protocol
+ * Dependencies:    Header (.h) files sensor_proto.h
+ *
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Author                       Date            Version       Comment
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ * Maxim Yudayev                16/10/2026      1.0           Raw, XOR and fixed-point delta encodings
+ *                                                            with zig-zag varint timestamps
+ *                              16/10/2026      1.1           Deltas are added in uint64_t, malformed
+ *                                                            frames wrap instead of overflowing. Raw
+ *                                                            timestamps out of int32_t range of the
+ *                                                            base are refused
+ *~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+ *
+ * Sensors report at fixed intervals and temperatures change slowly, so the timestamp delta of a
+ * reading fits in one varint byte and so does the fixed-point value delta. XOR keeps every bit of
+ * the value, it pays off for values that repeat or come from a coarse ADC, not for noisy ones.
+ *
+ ***************************************************************************************************/
+
+/**
+ * Includes
+ **/
+#include <string.h>
+#include "sensor_proto.h"
+
+#define VARINT_MAX 10 // bytes of the longest varint of a 64 bit number
+
+/**
+ * Private Prototypes
+ **/
+static int _put_varint(unsigned char * out, uint64_t number);
+static int _get_varint(const unsigned char * in, int len, uint64_t * number);
+static uint64_t _zigzag(int64_t number);
+static int64_t _unzigzag(uint64_t number);
+static int64_t _to_fixed(sensor_value_t value);
+static int64_t _add(int64_t a, int64_t b);
+static int64_t _sub(int64_t a, int64_t b);
+
+/**
+ * Functions
+ **/
+//
+int proto_codec_init(proto_codec_t * codec, uint8_t encoding, sensor_ts_t base_ts)
+{
+    if(encoding != PROTO_ENC_RAW && encoding != PROTO_ENC_XOR && encoding != PROTO_ENC_FIXED) return PROTO_FAILURE;
+
+    codec->encoding = encoding;
+    codec->ts = base_ts;
+    codec->value_bits = 0;
+    codec->fixed = 0;
+
+    return 0;
+}
+
+int proto_encode(proto_codec_t * codec, unsigned char * out, sensor_value_t value, sensor_ts_t ts)
+{
+    int pos = 0;
+
+    if(codec->encoding == PROTO_ENC_RAW) // the timestamp stays relative to the base
+    {
+        int64_t delta = _sub(ts, codec->ts);
+        if(delta < INT32_MIN || delta > INT32_MAX) return PROTO_FAILURE; // the reading needs a frame of its own
+        int32_t ts_delta = (int32_t) delta;
+        memcpy(out, &value, sizeof(value));
+        memcpy(&out[sizeof(value)], &ts_delta, sizeof(ts_delta));
+
+        return PROTO_RAW_READING_SIZE;
+    }
+
+    pos += _put_varint(out, _zigzag(_sub(ts, codec->ts)));
+    codec->ts = ts;
+
+    if(codec->encoding == PROTO_ENC_XOR)
+    {
+        uint64_t bits, diff;
+        int lead = 0, trail = 0;
+        memcpy(&bits, &value, sizeof(bits));
+        diff = bits ^ codec->value_bits;
+        codec->value_bits = bits;
+
+        if(diff == 0) lead = 8; // nothing changed, the control byte says it all
+        while(lead < 8 && (diff >> (56 - 8*lead)) == 0) lead++;
+        while(lead < 8 && ((diff >> (8*trail)) & 0xFF) == 0) trail++;
+        out[pos++] = (unsigned char) ((lead << 4) | trail);
+        for(int i = trail; i < 8 - lead; i++) out[pos++] = (unsigned char) (diff >> (8*i));
+    } else
+    {
+        int64_t fixed = _to_fixed(value);
+        pos += _put_varint(&out[pos], _zigzag(_sub(fixed, codec->fixed)));
+        codec->fixed = fixed;
+    }
+
+    return pos;
+}
+
+int proto_decode(proto_codec_t * codec, const unsigned char * in, int len, sensor_value_t * value, sensor_ts_t * ts)
+{
+    uint64_t number;
+    int pos, used;
+
+    if(codec->encoding == PROTO_ENC_RAW)
+    {
+        int32_t ts_delta;
+        if(len < (int) PROTO_RAW_READING_SIZE) return PROTO_FAILURE;
+        memcpy(value, in, sizeof(*value));
+        memcpy(&ts_delta, &in[sizeof(*value)], sizeof(ts_delta));
+        *ts = (sensor_ts_t) _add(codec->ts, ts_delta);
+
+        return PROTO_RAW_READING_SIZE;
+    }
+
+    if((pos = _get_varint(in, len, &number)) == PROTO_FAILURE) return PROTO_FAILURE;
+    codec->ts = (sensor_ts_t) _add(codec->ts, _unzigzag(number)); // deltas come straight from the network
+    *ts = codec->ts;
+
+    if(codec->encoding == PROTO_ENC_XOR)
+    {
+        uint64_t diff = 0;
+        if(pos >= len) return PROTO_FAILURE;
+        int lead = in[pos] >> 4, trail = in[pos] & 0x0F;
+        pos++;
+        if(lead + trail > 8 || pos + 8 - lead - trail > len) return PROTO_FAILURE;
+        for(int i = trail; i < 8 - lead; i++) diff |= (uint64_t) in[pos++] << (8*i);
+        codec->value_bits ^= diff;
+        memcpy(value, &(codec->value_bits), sizeof(*value));
+    } else
+    {
+        if((used = _get_varint(&in[pos], len - pos, &number)) == PROTO_FAILURE) return PROTO_FAILURE;
+        pos += used;
+        codec->fixed = _add(codec->fixed, _unzigzag(number));
+        *value = (sensor_value_t) codec->fixed / PROTO_FIXED_SCALE;
+    }
+
+    return pos;
+}
+
+static int _put_varint(unsigned char * out, uint64_t number)
+{
+    int pos = 0;
+    for(; number >= 0x80; number >>= 7) out[pos++] = (unsigned char) (number | 0x80);
+    out[pos++] = (unsigned char) number;
+
+    return pos;
+}
+
+// Returns the number of bytes read or PROTO_FAILURE if the varint is cut off or too long
+static int _get_varint(const unsigned char * in, int len, uint64_t * number)
+{
+    *number = 0;
+    for(int pos = 0; pos < len && pos < VARINT_MAX; pos++)
+    {
+        *number |= (uint64_t) (in[pos] & 0x7F) << (7*pos);
+        if(!(in[pos] & 0x80)) return pos + 1;
+    }
+
+    return PROTO_FAILURE;
+}
+
+// Maps small negative and positive numbers to small unsigned ones, 0 -1 1 -2 2 to 0 1 2 3 4
+static uint64_t _zigzag(int64_t number)
+{
+    return ((uint64_t) number << 1) ^ (uint64_t) -(int64_t) ((uint64_t) number >> 63);
+}
+
+static int64_t _unzigzag(uint64_t number)
+{
+    return (int64_t) (number >> 1) ^ -(int64_t) (number & 1);
+}
+
+// Two's complement wrap-around instead of signed overflow, a malformed frame yields garbage and not undefined behaviour
+static int64_t _add(int64_t a, int64_t b)
+{
+    return (int64_t) ((uint64_t) a + (uint64_t) b);
+}
+
+static int64_t _sub(int64_t a, int64_t b)
+{
+    return (int64_t) ((uint64_t) a - (uint64_t) b);
+}
+
+// Rounds half away from zero without libm
+static int64_t _to_fixed(sensor_value_t value)
+{
+    return (int64_t) (value*PROTO_FIXED_SCALE + ((value < 0) ? -0.5 : 0.5));
+}
@@ -0,0 +1,48 @@
+#ifndef _SENSOR_PROTO_H_
+#define _SENSOR_PROTO_H_
+
+#include <stdint.h>
+#include "config.h"
+
+#define PROTO_FAILURE -1
+
+/**
+ * Encoder and decoder of the readings inside a frame of the wire protocol, shared by sensor_node and
+ * connmgr. The header of a frame is not its business, only the readings that follow it
+ * Compressed encodings store every reading relative to the one before, so a frame is encoded and
+ * decoded in order with one codec, set up with the base timestamp of the frame
+ *  - PROTO_ENC_RAW     <value><ts - base_ts as int32_t>, 12 bytes
+ *  - PROTO_ENC_XOR     <ts delta><control byte><middle bytes of value XOR previous value>, the control
+ *                      byte holds the number of zero bytes above (high nibble) and below (low nibble)
+ *                      the middle bytes, an unchanged value takes the control byte only
+ *  - PROTO_ENC_FIXED   <ts delta><delta of the value in 1/PROTO_FIXED_SCALE>
+ * Deltas are zig-zag encoded and written as little-endian base 128 varints, 7 bits per byte with the
+ * top bit set on all bytes but the last. The previous value of the first reading is 0
+ **/
+typedef struct {
+    uint8_t encoding;
+    sensor_ts_t ts;         // previous timestamp, the base timestamp before the first reading
+    uint64_t value_bits;    // previous value (PROTO_ENC_XOR)
+    int64_t fixed;          // previous value in 1/PROTO_FIXED_SCALE (PROTO_ENC_FIXED)
+} proto_codec_t;
+
+/**
+ * Prepares 'codec' for the readings of a frame in 'encoding' with base timestamp 'base_ts'
+ * Returns PROTO_FAILURE if 'encoding' is not known
+ **/
+int proto_codec_init(proto_codec_t * codec, uint8_t encoding, sensor_ts_t base_ts);
+
+/**
+ * Writes the next reading of the frame to 'out', which has room for PROTO_MAX_READING_SIZE bytes
+ * Returns the number of bytes written or PROTO_FAILURE if PROTO_ENC_RAW cannot express 'ts' relative
+ * to the base timestamp, the reading has to start a new frame
+ **/
+int proto_encode(proto_codec_t * codec, unsigned char * out, sensor_value_t value, sensor_ts_t ts);
+
+/**
+ * Reads the next reading of the frame from the 'len' bytes at 'in'
+ * Returns the number of bytes read or PROTO_FAILURE if the reading is malformed or cut off
+ **/
+int proto_decode(proto_codec_t * codec, const unsigned char * in, int len, sensor_value_t * value, sensor_ts_t * ts);
+
+#endif /* _SENSOR_PROTO_H_ */